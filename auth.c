@@ -1,10 +1,6 @@
 #include "auth.h"
 #include "memory.h"
-
-// External string helpers
-extern int strcmp(const char* s1, const char* s2);
-extern void strcpy(char* dest, const char* src);
-extern int strlen(const char* str);
+#include "string.h"
 
 static user_t users[MAX_USERS];
 static int user_count = 0;
@@ -0,0 +1,277 @@
+#include "bench.h"
+#include "memory.h"
+#include "string.h"
+#include "timer.h"
+
+#define BENCH_ROUNDS 1000
+#define BENCH_MAX_LIVE 100000
+
+#define STRESS_SLOTS 2000
+#define STRESS_ROUNDS 200000
+
+// Each size is run until this much has been moved, at least a few times
+#define MEM_BYTES_PER_SIZE (64u * 1024 * 1024)
+#define MEM_MIN_PASSES 4
+#define MEM_MOVE_SHIFT 64 // memmove dest sits this far above src, overlapping
+
+static const uint32_t mem_sizes[] = {
+    8, 64, 512, 4 * 1024, 32 * 1024, 256 * 1024, 2 * 1024 * 1024, 8 * 1024 * 1024
+};
+#define MEM_SIZES (int)(sizeof(mem_sizes) / sizeof(mem_sizes[0]))
+#define MEM_MAX_SIZE (8 * 1024 * 1024)
+
+// Object sizes the fill cycles through: VFS nodes, short file contents, hit entries
+static const size_t fill_sizes[] = { 16, 24, 48, 64, 96 };
+#define FILL_SIZES (int)(sizeof(fill_sizes) / sizeof(fill_sizes[0]))
+
+// Append `s` left-aligned in a field of `width` characters. Like put_uint(),
+// leaves the line terminated and returns the end.
+static char* put_field(char* out, const char* s, int width) {
+    int n = 0;
+    while (s[n]) *out++ = s[n++];
+    while (n++ < width) *out++ = ' ';
+    *out = '\0';
+    return out;
+}
+
+// Append `v` right-aligned in a field of `width` characters
+static char* put_uint(char* out, uint32_t v, int width) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    for (int pad = width - n; pad > 0; pad--) *out++ = ' ';
+    while (n) *out++ = digits[--n];
+    *out = '\0';
+    return out;
+}
+
+static char* put_ulong(char* out, uint64_t v) {
+    return put_uint(out, v > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)v, 0);
+}
+
+// Start a report line: a label and a number
+static char* fmt_line(char* out, const char* label, uint64_t v) {
+    return put_ulong(put_field(out, label, 0), v);
+}
+
+// Average nanoseconds of one 64-byte alloc and one free with `count` other
+// objects live. Returns false if the fill ran out of memory.
+static bool bench_alloc_pair(void* (*alloc)(size_t), void (*release)(void*),
+                             void** live, int count, uint32_t* alloc_ns, uint32_t* free_ns) {
+    int n = 0;
+    while (n < count && (live[n] = alloc(fill_sizes[n % FILL_SIZES]))) n++;
+    bool ok = n == count;
+    
+    uint64_t alloc_cycles = 0, free_cycles = 0;
+    for (int i = 0; ok && i < BENCH_ROUNDS; i++) {
+        uint64_t t0 = rdtsc();
+        void* p = alloc(64);
+        uint64_t t1 = rdtsc();
+        release(p);
+        uint64_t t2 = rdtsc();
+        alloc_cycles += t1 - t0;
+        free_cycles += t2 - t1;
+    }
+    
+    while (n > 0) release(live[--n]);
+    *alloc_ns = timer_cycles_to_ns(alloc_cycles / BENCH_ROUNDS);
+    *free_ns = timer_cycles_to_ns(free_cycles / BENCH_ROUNDS);
+    return ok;
+}
+
+void bench_alloc(bench_emit_t emit) {
+    char line[BENCH_LINE_LEN];
+    void** live = (void**)heap_alloc(BENCH_MAX_LIVE * sizeof(void*));
+    if (!live) {
+        emit("bench: out of memory");
+        return;
+    }
+    
+    char* p = put_field(line, "ns/op", 13);
+    put_field(p, "  malloc    free    heap    free", 0);
+    emit(line);
+    
+    for (int count = 10; count <= BENCH_MAX_LIVE; count *= 10) {
+        uint32_t alloc_ns, free_ns;
+        p = put_uint(line, count, 6);
+        p = put_field(p, " live", 7);
+        if (!bench_alloc_pair(malloc, free, live, count, &alloc_ns, &free_ns)) {
+            put_field(p, "  out of memory", 0);
+            emit(line);
+            break;
+        }
+        p = put_uint(p, alloc_ns, 8);
+        p = put_uint(p, free_ns, 8);
+        if (bench_alloc_pair(heap_alloc, heap_free, live, count, &alloc_ns, &free_ns)) {
+            p = put_uint(p, alloc_ns, 8);
+            p = put_uint(p, free_ns, 8);
+        } else {
+            put_field(p, "       -       -", 0);
+        }
+        emit(line);
+    }
+    heap_free(live);
+}
+
+static uint32_t bench_random(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+// Mostly small blocks, some file-sized ones and the odd large buffer, freed
+// and reallocated in random order like files being rewritten
+static size_t stress_size(uint32_t* state) {
+    uint32_t r = bench_random(state) % 100;
+    if (r < 70) return 16 + bench_random(state) % 240;
+    if (r < 95) return 256 + bench_random(state) % 8192;
+    return 8192 + bench_random(state) % 65536;
+}
+
+void bench_heap(bench_emit_t emit) {
+    char line[BENCH_LINE_LEN];
+    void** slots = (void**)heap_alloc(STRESS_SLOTS * sizeof(void*));
+    if (!slots) {
+        emit("bench: out of memory");
+        return;
+    }
+    memset(slots, 0, STRESS_SLOTS * sizeof(void*));
+    
+    uint32_t seed = 1;
+    uint64_t alloc_total = 0, alloc_worst = 0, free_total = 0, free_worst = 0;
+    uint32_t allocs = 0, frees = 0, failed = 0;
+    for (int round = 0; round < STRESS_ROUNDS; round++) {
+        void** slot = &slots[bench_random(&seed) % STRESS_SLOTS];
+        size_t size = *slot ? 0 : stress_size(&seed);
+        
+        // Keep the timer interrupt out of the measured window
+        asm volatile ("cli");
+        uint64_t t0 = rdtsc();
+        if (*slot) {
+            heap_free(*slot);
+            *slot = NULL;
+        } else {
+            *slot = heap_alloc(size);
+        }
+        uint64_t cycles = rdtsc() - t0;
+        asm volatile ("sti");
+        
+        if (size == 0) {
+            free_total += cycles;
+            if (cycles > free_worst) free_worst = cycles;
+            frees++;
+        } else {
+            alloc_total += cycles;
+            if (cycles > alloc_worst) alloc_worst = cycles;
+            allocs++;
+            if (!*slot) failed++;
+        }
+    }
+    
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+    for (int i = 0; i < STRESS_SLOTS; i++) heap_free(slots[i]);
+    heap_free(slots);
+    heap_stats_t after;
+    heap_get_stats(&after);
+    
+    char* p = fmt_line(line, "malloc: avg ", timer_cycles_to_ns(alloc_total / (allocs ? allocs : 1)));
+    p = put_field(p, " ns, worst ", 0);
+    p = put_ulong(p, timer_cycles_to_ns(alloc_worst));
+    p = put_field(p, " ns, ", 0);
+    p = put_ulong(p, failed);
+    put_field(p, " failed", 0);
+    emit(line);
+    
+    p = fmt_line(line, "free:   avg ", timer_cycles_to_ns(free_total / (frees ? frees : 1)));
+    p = put_field(p, " ns, worst ", 0);
+    p = put_ulong(p, timer_cycles_to_ns(free_worst));
+    put_field(p, " ns", 0);
+    emit(line);
+    
+    // Share of free memory not usable by one request the size of all of it
+    uint32_t percent = stats.free ? 100 - (uint32_t)(stats.largest_free * 100 / stats.free) : 0;
+    p = fmt_line(line, "fragmentation: ", percent);
+    p = put_field(p, "% (largest ", 0);
+    p = put_ulong(p, stats.largest_free / 1024);
+    p = put_field(p, " of ", 0);
+    p = put_ulong(p, stats.free / 1024);
+    p = put_field(p, " KB free, ", 0);
+    p = put_ulong(p, stats.free_blocks);
+    put_field(p, " blocks)", 0);
+    emit(line);
+    
+    p = fmt_line(line, "after release: ", after.free / 1024);
+    p = put_field(p, " KB free in ", 0);
+    p = put_ulong(p, after.free_blocks);
+    put_field(p, " blocks", 0);
+    emit(line);
+}
+
+enum { MEM_COPY, MEM_SET, MEM_MOVE };
+
+// MB/s of one operation over `size` bytes, repeated until MEM_BYTES_PER_SIZE
+static uint32_t mem_rate(int op, uint8_t* dst, uint8_t* src, uint32_t size) {
+    uint32_t passes = MEM_BYTES_PER_SIZE / size;
+    if (passes < MEM_MIN_PASSES) passes = MEM_MIN_PASSES;
+    
+    // One untimed pass so the buffers are in the TLB (and cache, if they fit)
+    memcpy(dst, src, size);
+    
+    uint64_t t0 = rdtsc();
+    for (uint32_t i = 0; i < passes; i++) {
+        switch (op) {
+        case MEM_COPY: memcpy(dst, src, size); break;
+        case MEM_SET: memset(dst, i, size); break;
+        case MEM_MOVE: memmove(src + MEM_MOVE_SHIFT, src, size); break;
+        }
+        // Keep the compiler from merging or dropping the calls
+        asm volatile ("" : : "r"(dst), "r"(src) : "memory");
+    }
+    uint64_t ns = timer_cycles_to_ns(rdtsc() - t0);
+    return ns ? (uint32_t)((uint64_t)passes * size * 1000 / ns) : 0;
+}
+
+void bench_mem(bench_emit_t emit) {
+    char line[BENCH_LINE_LEN];
+    uint8_t* src = (uint8_t*)heap_alloc(MEM_MAX_SIZE + MEM_MOVE_SHIFT);
+    uint8_t* dst = (uint8_t*)heap_alloc(MEM_MAX_SIZE);
+    if (!src || !dst) {
+        heap_free(src);
+        heap_free(dst);
+        emit("bench: out of memory");
+        return;
+    }
+    memset(src, 0x5A, MEM_MAX_SIZE + MEM_MOVE_SHIFT);
+    
+    char* p = put_field(line, "copies: ", 0);
+    put_field(p, string_copy_method(), 0);
+    emit(line);
+    
+    p = put_field(line, "MB/s", 9);
+    put_field(p, "   memcpy   memset  memmove", 0);
+    emit(line);
+    
+    for (int i = 0; i < MEM_SIZES; i++) {
+        uint32_t size = mem_sizes[i];
+        if (size >= 1024 * 1024) {
+            p = put_uint(line, size / (1024 * 1024), 6);
+            p = put_field(p, " MB", 3);
+        } else if (size >= 1024) {
+            p = put_uint(line, size / 1024, 6);
+            p = put_field(p, " KB", 3);
+        } else {
+            p = put_uint(line, size, 6);
+            p = put_field(p, " B", 3);
+        }
+        p = put_uint(p, mem_rate(MEM_COPY, dst, src, size), 9);
+        p = put_uint(p, mem_rate(MEM_SET, dst, src, size), 9);
+        put_uint(p, mem_rate(MEM_MOVE, dst, src, size), 9);
+        emit(line);
+    }
+    
+    heap_free(src);
+    heap_free(dst);
+}
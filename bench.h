@@ -0,0 +1,22 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Benchmarks run from the shell (`bench ...`). Each reports through `emit`,
+// one line at a time. Lines are built in BENCH_LINE_LEN-byte buffers without
+// bounds checks; numbers are at most 10 digits, so the longest report line is
+// under 100 bytes. Same as the terminal's line length, so nothing is cut.
+#define BENCH_LINE_LEN 256
+
+typedef void (*bench_emit_t)(const char* line);
+
+// malloc/free latency against the number of live objects, slab caches
+// versus the heap on its own
+void bench_alloc(bench_emit_t emit);
+
+// Random alloc/free churn on the heap: worst-case latency and fragmentation
+void bench_heap(bench_emit_t emit);
+
+// memcpy/memset/memmove throughput from 8 bytes to 8 MB
+void bench_mem(bench_emit_t emit);
+
+#endif
@@ -0,0 +1,310 @@
+#include "blit.h"
+#include "cpu.h"
+
+typedef uint32_t v4u32 __attribute__((vector_size(16), may_alias));
+typedef uint16_t v8u16 __attribute__((vector_size(16), may_alias));
+typedef long long v2i64 __attribute__((vector_size(16), may_alias));
+typedef uint32_t v8u32 __attribute__((vector_size(32), may_alias));
+typedef uint16_t v16u16 __attribute__((vector_size(32), may_alias));
+
+static int use_sse2 = 0;
+static int use_avx2 = 0;
+
+void blit_init() {
+    use_sse2 = cpu_has(CPU_FEATURE_SSE2);
+    use_avx2 = cpu_has(CPU_FEATURE_AVX2);
+}
+
+static inline void fill_rep(uint32_t* dst, uint32_t color, size_t count) {
+    asm volatile ("rep stosl"
+                  : "+D"(dst), "+c"(count)
+                  : "a"(color)
+                  : "memory");
+}
+
+static inline void copy_rep(uint32_t* dst, const uint32_t* src, size_t count) {
+    asm volatile ("rep movsl"
+                  : "+D"(dst), "+S"(src), "+c"(count)
+                  :
+                  : "memory");
+}
+
+// Scalar head until dst is 16-byte aligned; returns how many pixels it wrote
+static inline size_t fill_head(uint32_t* dst, uint32_t color, size_t count) {
+    size_t n = 0;
+    while (n < count && ((uintptr_t)(dst + n) & 15)) {
+        dst[n++] = color;
+    }
+    return n;
+}
+
+__attribute__((target("sse2")))
+static void fill_sse2(uint32_t* dst, uint32_t color, size_t count, int stream) {
+    size_t i = fill_head(dst, color, count);
+    v4u32 v = { color, color, color, color };
+
+    if (stream) {
+        for (; i + 16 <= count; i += 16) {
+            __builtin_ia32_movntdq((v2i64*)(dst + i), (v2i64)v);
+            __builtin_ia32_movntdq((v2i64*)(dst + i + 4), (v2i64)v);
+            __builtin_ia32_movntdq((v2i64*)(dst + i + 8), (v2i64)v);
+            __builtin_ia32_movntdq((v2i64*)(dst + i + 12), (v2i64)v);
+        }
+    } else {
+        for (; i + 16 <= count; i += 16) {
+            *(v4u32*)(dst + i) = v;
+            *(v4u32*)(dst + i + 4) = v;
+            *(v4u32*)(dst + i + 8) = v;
+            *(v4u32*)(dst + i + 12) = v;
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        *(v4u32*)(dst + i) = v;
+    }
+    for (; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+__attribute__((target("sse2")))
+static void copy_sse2(uint32_t* dst, const uint32_t* src, size_t count, int stream) {
+    size_t i = 0;
+    while (i < count && ((uintptr_t)(dst + i) & 15)) {
+        dst[i] = src[i];
+        i++;
+    }
+
+    // Destination is aligned now; the source may not be, so load unaligned
+    if (stream) {
+        for (; i + 8 <= count; i += 8) {
+            v4u32 a, b;
+            __builtin_memcpy(&a, src + i, 16);
+            __builtin_memcpy(&b, src + i + 4, 16);
+            __builtin_ia32_movntdq((v2i64*)(dst + i), (v2i64)a);
+            __builtin_ia32_movntdq((v2i64*)(dst + i + 4), (v2i64)b);
+        }
+    } else {
+        for (; i + 8 <= count; i += 8) {
+            v4u32 a, b;
+            __builtin_memcpy(&a, src + i, 16);
+            __builtin_memcpy(&b, src + i + 4, 16);
+            *(v4u32*)(dst + i) = a;
+            *(v4u32*)(dst + i + 4) = b;
+        }
+    }
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+void span_fill(uint32_t* dst, uint32_t color, size_t count) {
+    if (count < 8) {
+        while (count--) *dst++ = color;
+    } else if (use_sse2) {
+        fill_sse2(dst, color, count, 0);
+    } else {
+        fill_rep(dst, color, count);
+    }
+}
+
+// Always stream; for large fills whose result will not be read back soon.
+// Callers must issue blit_stream_fence() before the memory is handed to anyone else.
+void span_fill_stream(uint32_t* dst, uint32_t color, size_t count) {
+    if (use_sse2) {
+        fill_sse2(dst, color, count, 1);
+    } else {
+        fill_rep(dst, color, count);
+    }
+}
+
+void span_copy(uint32_t* dst, const uint32_t* src, size_t count) {
+    if (count < 8) {
+        while (count--) *dst++ = *src++;
+    } else if (use_sse2) {
+        copy_sse2(dst, src, count, 0);
+    } else {
+        copy_rep(dst, src, count);
+    }
+}
+
+// Non-temporal copy, used when the destination is the framebuffer
+void span_copy_stream(uint32_t* dst, const uint32_t* src, size_t count) {
+    if (use_sse2 && count >= 8) {
+        copy_sse2(dst, src, count, 1);
+    } else {
+        copy_rep(dst, src, count);
+    }
+}
+
+// Overlap-safe copy within one row
+void span_move(uint32_t* dst, const uint32_t* src, size_t count) {
+    if (dst <= src || dst >= src + count) {
+        span_copy(dst, src, count);
+        return;
+    }
+    // Overlapping with dst after src: copy backwards
+    while (count--) {
+        dst[count] = src[count];
+    }
+}
+
+// Blending works on two channels per 32-bit word: red/blue in one mask, alpha/green
+// shifted down into the other, so each channel sits in its own 16-bit lane.
+// With alpha scaled to 0..256, channel * 256 still fits a lane, and the output
+// is (dst * (256 - a) + src * a) >> 8. The back buffer is opaque, so the
+// resulting alpha is forced to 0xFF.
+#define BLEND_MASK 0x00FF00FF
+
+static inline uint32_t alpha256(uint32_t color) {
+    uint32_t a = color >> 24;
+    return a + (a >> 7);
+}
+
+static inline uint32_t blend_pixel(uint32_t dst, uint32_t src_rb, uint32_t src_g, uint32_t ia) {
+    uint32_t rb = (((dst & BLEND_MASK) * ia + src_rb) >> 8) & BLEND_MASK;
+    uint32_t g = (((dst & 0x0000FF00) * ia + src_g) >> 8) & 0x0000FF00;
+    return 0xFF000000 | rb | g;
+}
+
+__attribute__((target("sse2")))
+static size_t blend_sse2(uint32_t* dst, size_t count, uint32_t src_rb, uint32_t src_ag, uint16_t ia) {
+    const v4u32 mask = { BLEND_MASK, BLEND_MASK, BLEND_MASK, BLEND_MASK };
+    const v4u32 opaque = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+    const v8u16 iav = { ia, ia, ia, ia, ia, ia, ia, ia };
+    const v4u32 srb = { src_rb, src_rb, src_rb, src_rb };
+    const v4u32 sag = { src_ag, src_ag, src_ag, src_ag };
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        v4u32 d;
+        __builtin_memcpy(&d, dst + i, 16);
+        v8u16 rb = (v8u16)(d & mask);
+        v8u16 ag = (v8u16)((d >> 8) & mask);
+        rb = (rb * iav + (v8u16)srb) >> 8;
+        ag = (ag * iav + (v8u16)sag) >> 8;
+        v4u32 out = ((v4u32)rb & mask) | (((v4u32)ag & mask) << 8) | opaque;
+        __builtin_memcpy(dst + i, &out, 16);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t blend_avx2(uint32_t* dst, size_t count, uint32_t src_rb, uint32_t src_ag, uint16_t ia) {
+    const v8u32 mask = { BLEND_MASK, BLEND_MASK, BLEND_MASK, BLEND_MASK,
+                         BLEND_MASK, BLEND_MASK, BLEND_MASK, BLEND_MASK };
+    const v8u32 opaque = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+                           0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+    const v16u16 iav = { ia, ia, ia, ia, ia, ia, ia, ia, ia, ia, ia, ia, ia, ia, ia, ia };
+    const v8u32 srb = { src_rb, src_rb, src_rb, src_rb, src_rb, src_rb, src_rb, src_rb };
+    const v8u32 sag = { src_ag, src_ag, src_ag, src_ag, src_ag, src_ag, src_ag, src_ag };
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        v8u32 d;
+        __builtin_memcpy(&d, dst + i, 32);
+        v16u16 rb = (v16u16)(d & mask);
+        v16u16 ag = (v16u16)((d >> 8) & mask);
+        rb = (rb * iav + (v16u16)srb) >> 8;
+        ag = (ag * iav + (v16u16)sag) >> 8;
+        v8u32 out = ((v8u32)rb & mask) | (((v8u32)ag & mask) << 8) | opaque;
+        __builtin_memcpy(dst + i, &out, 32);
+    }
+    return i;
+}
+
+// Blend one translucent color over `count` destination pixels
+void span_blend(uint32_t* dst, uint32_t color, size_t count) {
+    uint32_t a = alpha256(color);
+    if (a == 0) return;
+    if (a == 256) {
+        span_fill(dst, color, count);
+        return;
+    }
+
+    uint32_t ia = 256 - a;
+    uint32_t src_rb = (color & BLEND_MASK) * a;
+    uint32_t src_g = (color & 0x0000FF00) * a;
+
+    size_t i = 0;
+    if (use_avx2) {
+        i = blend_avx2(dst, count, src_rb, src_g >> 8, (uint16_t)ia);
+    } else if (use_sse2) {
+        i = blend_sse2(dst, count, src_rb, src_g >> 8, (uint16_t)ia);
+    }
+    for (; i < count; i++) {
+        dst[i] = blend_pixel(dst[i], src_rb, src_g, ia);
+    }
+}
+
+__attribute__((target("sse2")))
+static size_t blend_copy_sse2(uint32_t* dst, const uint32_t* src, size_t count) {
+    const v4u32 mask = { BLEND_MASK, BLEND_MASK, BLEND_MASK, BLEND_MASK };
+    const v4u32 opaque = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+    const v8u16 k256 = { 256, 256, 256, 256, 256, 256, 256, 256 };
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        v4u32 d, s;
+        __builtin_memcpy(&d, dst + i, 16);
+        __builtin_memcpy(&s, src + i, 16);
+
+        // Broadcast each pixel's alpha into both of its 16-bit lanes
+        v4u32 a = s >> 24;
+        v8u16 a16 = (v8u16)(a | (a << 16));
+        a16 = a16 + (a16 >> 7);
+        v8u16 ia16 = k256 - a16;
+
+        v8u16 rb = (v8u16)(d & mask) * ia16 + (v8u16)(s & mask) * a16;
+        v8u16 ag = (v8u16)((d >> 8) & mask) * ia16 + (v8u16)((s >> 8) & mask) * a16;
+        v4u32 out = ((v4u32)(rb >> 8) & mask) | (((v4u32)(ag >> 8) & mask) << 8) | opaque;
+        __builtin_memcpy(dst + i, &out, 16);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t blend_copy_avx2(uint32_t* dst, const uint32_t* src, size_t count) {
+    const v8u32 mask = { BLEND_MASK, BLEND_MASK, BLEND_MASK, BLEND_MASK,
+                         BLEND_MASK, BLEND_MASK, BLEND_MASK, BLEND_MASK };
+    const v8u32 opaque = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+                           0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+    const v16u16 k256 = { 256, 256, 256, 256, 256, 256, 256, 256,
+                          256, 256, 256, 256, 256, 256, 256, 256 };
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        v8u32 d, s;
+        __builtin_memcpy(&d, dst + i, 32);
+        __builtin_memcpy(&s, src + i, 32);
+
+        v8u32 a = s >> 24;
+        v16u16 a16 = (v16u16)(a | (a << 16));
+        a16 = a16 + (a16 >> 7);
+        v16u16 ia16 = k256 - a16;
+
+        v16u16 rb = (v16u16)(d & mask) * ia16 + (v16u16)(s & mask) * a16;
+        v16u16 ag = (v16u16)((d >> 8) & mask) * ia16 + (v16u16)((s >> 8) & mask) * a16;
+        v8u32 out = ((v8u32)(rb >> 8) & mask) | (((v8u32)(ag >> 8) & mask) << 8) | opaque;
+        __builtin_memcpy(dst + i, &out, 32);
+    }
+    return i;
+}
+
+// Composite `count` source pixels, each with its own (non-premultiplied) alpha
+void span_blend_copy(uint32_t* dst, const uint32_t* src, size_t count) {
+    size_t i = 0;
+    if (use_avx2) {
+        i = blend_copy_avx2(dst, src, count);
+    } else if (use_sse2) {
+        i = blend_copy_sse2(dst, src, count);
+    }
+    for (; i < count; i++) {
+        uint32_t a = alpha256(src[i]);
+        uint32_t s = src[i];
+        dst[i] = blend_pixel(dst[i], (s & BLEND_MASK) * a, (s & 0x0000FF00) * a, 256 - a);
+    }
+}
+
+void blit_stream_fence() {
+    asm volatile ("sfence" ::: "memory");
+}
@@ -0,0 +1,23 @@
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Row kernels used by the graphics primitives. Callers clip first; these just
+// store `count` 32-bit pixels as fast as the CPU allows.
+
+// Fills covering at least this many pixels should stream past the cache
+#define BLIT_STREAM_THRESHOLD (256 * 1024 / 4)
+
+void blit_init();
+void span_fill(uint32_t* dst, uint32_t color, size_t count);
+void span_fill_stream(uint32_t* dst, uint32_t color, size_t count);
+void span_copy(uint32_t* dst, const uint32_t* src, size_t count);
+void span_copy_stream(uint32_t* dst, const uint32_t* src, size_t count);
+void span_move(uint32_t* dst, const uint32_t* src, size_t count);
+void span_blend(uint32_t* dst, uint32_t color, size_t count);
+void span_blend_copy(uint32_t* dst, const uint32_t* src, size_t count);
+void blit_stream_fence();
+
+#endif
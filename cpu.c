@@ -0,0 +1,69 @@
+#include "cpu.h"
+
+static uint32_t features = 0;
+
+// AVX needs XSAVE plus OS support before its instructions are usable
+static bool has_xsave_avx = false;
+static bool has_avx2_insns = false;
+
+static void detect_features() {
+    uint32_t a, b, c, d;
+
+    cpuid(0, 0, &a, &b, &c, &d);
+    uint32_t max_leaf = a;
+    if (max_leaf < 1) return;
+
+    cpuid(1, 0, &a, &b, &c, &d);
+    if (d & (1 << 26)) features |= CPU_FEATURE_SSE2;
+    if (d & (1 << 16)) features |= CPU_FEATURE_PAT;
+    if ((c & (1 << 26)) && (c & (1 << 28))) has_xsave_avx = true;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, &a, &b, &c, &d);
+        if (b & (1 << 5)) has_avx2_insns = true;
+        if (b & (1 << 9)) features |= CPU_FEATURE_ERMS;
+    }
+}
+
+// Turn on SSE state so the vector blit kernels can run. The kernel itself is
+// built with -mno-sse, so only code that explicitly opts in touches XMM registers.
+static void enable_sse() {
+    uint64_t cr0, cr4;
+    asm volatile ("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(1ull << 2); // EM: no x87 emulation
+    cr0 |= (1ull << 1);  // MP: monitor coprocessor
+    asm volatile ("mov %0, %%cr0" : : "r"(cr0));
+
+    asm volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1ull << 9);  // OSFXSR
+    cr4 |= (1ull << 10); // OSXMMEXCPT
+    asm volatile ("mov %0, %%cr4" : : "r"(cr4));
+}
+
+// Enable XSAVE and let XCR0 cover x87, SSE and AVX state
+static void enable_avx() {
+    uint64_t cr4;
+    asm volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1ull << 18); // OSXSAVE
+    asm volatile ("mov %0, %%cr4" : : "r"(cr4));
+
+    uint32_t lo, hi;
+    asm volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    lo |= 0x7;
+    asm volatile ("xsetbv" : : "a"(lo), "d"(hi), "c"(0));
+}
+
+void cpu_init() {
+    detect_features();
+    if (features & CPU_FEATURE_SSE2) {
+        enable_sse();
+        if (has_xsave_avx) {
+            enable_avx();
+            if (has_avx2_insns) features |= CPU_FEATURE_AVX2;
+        }
+    }
+}
+
+bool cpu_has(uint32_t feature) {
+    return (features & feature) == feature;
+}
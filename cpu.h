@@ -0,0 +1,33 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Feature bits reported by cpu_has()
+#define CPU_FEATURE_SSE2 (1 << 0)
+#define CPU_FEATURE_AVX2 (1 << 1) // Only reported once the OS has enabled AVX state
+#define CPU_FEATURE_PAT  (1 << 2)
+#define CPU_FEATURE_ERMS (1 << 3) // Enhanced rep movsb/stosb
+
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile ("cpuid"
+                  : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+                  : "a"(leaf), "c"(subleaf));
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+void cpu_init();
+bool cpu_has(uint32_t feature);
+
+#endif
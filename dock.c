@@ -1,7 +1,9 @@
 #include "dock.h"
 #include "graphics.h"
 #include "window.h"
+#include "hittest.h"
 
+// Layout before UI scaling (see ui_px())
 #define DOCK_WIDTH 400
 #define DOCK_HEIGHT 90
 #define BASE_ICON_SIZE 48
@@ -12,8 +14,42 @@
 
 static int dock_x, dock_y;
 static dock_icon_t icons[NUM_ICONS];
+static hit_region_t* icon_hits[NUM_ICONS];
 
-extern struct limine_framebuffer* fb; // Access from graphics.c
+// Scaled layout, fixed once the mode is known
+static int dock_w, dock_h;
+static int base_size, max_size, icon_gap, magnify_range;
+
+// Centered along the bottom edge of the screen
+static void dock_layout() {
+    dock_w = ui_px(DOCK_WIDTH);
+    dock_h = ui_px(DOCK_HEIGHT);
+    base_size = ui_px(BASE_ICON_SIZE);
+    max_size = ui_px(MAX_ICON_SIZE);
+    icon_gap = ui_px(ICON_GAP);
+    magnify_range = ui_px(MAGNIFY_RANGE);
+    dock_x = (graphics_width() - dock_w) / 2;
+    dock_y = graphics_height() - dock_h - ui_px(10);
+    
+    for (int i = 0; i < NUM_ICONS; i++) {
+        icons[i].base_x = dock_x + ui_px(24) + i * (base_size + icon_gap);
+        icons[i].base_y = dock_y + ui_px(20);
+    }
+}
+
+// Clickable square of a (possibly magnified) icon, cut to the dock's height
+static void dock_icon_rect(int i, int* x, int* y, int* w, int* h) {
+    int size = icons[i].current_size;
+    *x = icons[i].base_x - (size - base_size) / 2;
+    *y = icons[i].base_y - (size - base_size);
+    *w = size;
+    *h = size;
+    if (*y < dock_y) {
+        *h -= dock_y - *y;
+        *y = dock_y;
+    }
+    if (*y + *h > dock_y + dock_h + 1) *h = dock_y + dock_h + 1 - *y;
+}
 
 // Simple square root approximation for distance calculation
 static int isqrt(int n) {
@@ -45,30 +81,27 @@ void dock_init() {
     icons[3].label = "Settings";
     icons[3].is_running = false;
     
-    // Set base sizes
+    dock_layout();
+
+    // Set base sizes and file the icons with the hit-test grid. Icons sit below
+    // every window; where magnified icons overlap, the leftmost wins.
     for (int i = 0; i < NUM_ICONS; i++) {
-        icons[i].current_size = BASE_ICON_SIZE;
+        icons[i].current_size = base_size;
+        int x, y, w, h;
+        dock_icon_rect(i, &x, &y, &w, &h);
+        icon_hits[i] = hittest_add(x, y, w, h, HIT_DOCK_ICON, NULL, i, -1 - i);
     }
 }
 
 void dock_update_magnification(int mouse_x, int mouse_y) {
-    // Calculate dock position
-    dock_x = (800 - DOCK_WIDTH) / 2;
-    dock_y = 600 - DOCK_HEIGHT - 10;
-    
-    int start_x = dock_x + 24;
-    int icon_y = dock_y + 20;
+    int shrink_step = ui_px(2);
     
     // Check if mouse is near dock
-    bool near_dock = (mouse_y >= dock_y - 20 && mouse_y <= dock_y + DOCK_HEIGHT);
+    bool near_dock = (mouse_y >= dock_y - ui_px(20) && mouse_y <= dock_y + dock_h);
     
     for (int i = 0; i < NUM_ICONS; i++) {
-        int icon_x = start_x + i * (BASE_ICON_SIZE + ICON_GAP);
-        int icon_center_x = icon_x + BASE_ICON_SIZE / 2;
-        int icon_center_y = icon_y + BASE_ICON_SIZE / 2;
-        
-        icons[i].base_x = icon_x;
-        icons[i].base_y = icon_y;
+        int icon_center_x = icons[i].base_x + base_size / 2;
+        int icon_center_y = icons[i].base_y + base_size / 2;
         
         if (near_dock) {
             // Calculate distance from mouse to icon center
@@ -76,104 +109,101 @@ void dock_update_magnification(int mouse_x, int mouse_y) {
             int dy = mouse_y - icon_center_y;
             int distance = isqrt(dx * dx + dy * dy);
             
-            if (distance < MAGNIFY_RANGE) {
+            if (distance < magnify_range) {
                 // Apply magnification based on distance
-                int magnify = ((MAGNIFY_RANGE - distance) * (MAX_ICON_SIZE - BASE_ICON_SIZE)) / MAGNIFY_RANGE;
-                icons[i].current_size = BASE_ICON_SIZE + magnify;
+                int magnify = ((magnify_range - distance) * (max_size - base_size)) / magnify_range;
+                icons[i].current_size = base_size + magnify;
             } else {
                 // Smooth return to base size
-                if (icons[i].current_size > BASE_ICON_SIZE) {
-                    icons[i].current_size -= 2;
+                if (icons[i].current_size > base_size) {
+                    icons[i].current_size -= shrink_step;
                 }
             }
         } else {
             // Return to base size when mouse is away
-            if (icons[i].current_size > BASE_ICON_SIZE) {
-                icons[i].current_size -= 2;
+            if (icons[i].current_size > base_size) {
+                icons[i].current_size -= shrink_step;
             }
         }
         
         // Clamp size
-        if (icons[i].current_size < BASE_ICON_SIZE) {
-            icons[i].current_size = BASE_ICON_SIZE;
+        if (icons[i].current_size < base_size) {
+            icons[i].current_size = base_size;
         }
-        if (icons[i].current_size > MAX_ICON_SIZE) {
-            icons[i].current_size = MAX_ICON_SIZE;
+        if (icons[i].current_size > max_size) {
+            icons[i].current_size = max_size;
         }
+        
+        int x, y, w, h;
+        dock_icon_rect(i, &x, &y, &w, &h);
+        hittest_move(icon_hits[i], x, y, w, h);
     }
 }
 
 void dock_render() {
-    // Calculate dock position
-    dock_x = (800 - DOCK_WIDTH) / 2;
-    dock_y = 600 - DOCK_HEIGHT - 10;
+    // The dock is translucent, so composite it over fresh wallpaper each time.
+    // Magnified icons rise above the dock; restoring that headroom as well means
+    // icons shrinking back leave no trail.
+    int top = dock_y + ui_px(20) - (max_size - base_size);
+    draw_desktop_region(dock_x, top, dock_w, dock_y + dock_h - top);
     
     // Dock background with subtle transparency effect
-    draw_rect(dock_x, dock_y, DOCK_WIDTH, DOCK_HEIGHT, 0xFFE5E5E5);
+    draw_rect(dock_x, dock_y, dock_w, dock_h, COLOR_DOCK_BG);
     
     // Subtle top border
-    draw_rect(dock_x, dock_y, DOCK_WIDTH, 1, 0xFFCCCCCC);
+    draw_rect(dock_x, dock_y, dock_w, 1, 0xFFCCCCCC);
     
     // Render icons
     for (int i = 0; i < NUM_ICONS; i++) {
         int size = icons[i].current_size;
         
         // Center the icon based on its current size
-        int offset = (MAX_ICON_SIZE - size) / 2;
-        int x = icons[i].base_x - (size - BASE_ICON_SIZE) / 2;
-        int y = icons[i].base_y - (size - BASE_ICON_SIZE) + offset;
+        int offset = (max_size - size) / 2;
+        int x = icons[i].base_x - (size - base_size) / 2;
+        int y = icons[i].base_y - (size - base_size) + offset;
         
         // Draw icon shadow for depth
-        draw_rect(x + 2, y + 2, size, size, 0x33000000);
+        draw_rect(x + ui_px(2), y + ui_px(2), size, size, 0x33000000);
         
         // Draw icon
         draw_rect(x, y, size, size, icons[i].color);
         
         // Draw running indicator (small dot below icon)
         if (icons[i].is_running) {
-            int dot_x = icons[i].base_x + BASE_ICON_SIZE / 2 - 2;
-            int dot_y = dock_y + DOCK_HEIGHT - 8;
-            draw_rect(dot_x, dot_y, 4, 4, 0xFF4A4A4A);
+            int dot = ui_px(4);
+            int dot_x = icons[i].base_x + base_size / 2 - dot / 2;
+            int dot_y = dock_y + dock_h - ui_px(8);
+            draw_rect(dot_x, dot_y, dot, dot, 0xFF4A4A4A);
         }
     }
 }
 
 void dock_handle_click(int x, int y) {
-    // Check if click is within dock area
-    if (y < dock_y || y > dock_y + DOCK_HEIGHT) {
-        return;
+    hit_t hit = hittest_at(x, y);
+    if (hit.kind != HIT_DOCK_ICON) return;
+    int i = hit.index;
+    
+    // Handle click based on icon
+    window_t* win = NULL;
+    switch (i) {
+        case 0: // Finder
+            win = wm_create_window(ui_px(200), ui_px(100), ui_px(450), ui_px(380), "Finder", WINDOW_FILE_BROWSER);
+            break;
+        case 1: // Safari
+            win = wm_create_window(ui_px(180), ui_px(120), ui_px(500), ui_px(400), "Safari", WINDOW_FILE_BROWSER);
+            break;
+        case 2: // Terminal
+            win = wm_create_window(ui_px(120), ui_px(150), ui_px(500), ui_px(320), "Terminal", WINDOW_TERMINAL);
+            break;
+        case 3: // Settings
+            win = wm_create_window(ui_px(250), ui_px(200), ui_px(380), ui_px(250), "About AquaOS", WINDOW_ABOUT);
+            break;
     }
     
-    // Check each icon
-    for (int i = 0; i < NUM_ICONS; i++) {
-        int size = icons[i].current_size;
-        int icon_x = icons[i].base_x - (size - BASE_ICON_SIZE) / 2;
-        int icon_y = icons[i].base_y - (size - BASE_ICON_SIZE);
-        
-        if (x >= icon_x && x < icon_x + size &&
-            y >= icon_y && y < icon_y + size) {
-            
-            // Handle click based on icon
-            switch (i) {
-                case 0: // Finder
-                    wm_create_window(200, 100, 450, 380, "Finder", WINDOW_FILE_BROWSER);
-                    icons[i].is_running = true;
-                    break;
-                case 1: // Safari
-                    wm_create_window(180, 120, 500, 400, "Safari", WINDOW_FILE_BROWSER);
-                    icons[i].is_running = true;
-                    break;
-                case 2: // Terminal
-                    wm_create_window(120, 150, 500, 320, "Terminal", WINDOW_TERMINAL);
-                    icons[i].is_running = true;
-                    break;
-                case 3: // Settings
-                    wm_create_window(250, 200, 380, 250, "About AquaOS", WINDOW_ABOUT);
-                    icons[i].is_running = true;
-                    break;
-            }
-            return;
-        }
+    // The running dot stays until the app's last window is closed
+    if (win) {
+        win->dock_icon = i;
+        icons[i].is_running = true;
     }
 }
 
@@ -0,0 +1,74 @@
+#include "frame.h"
+#include "timer.h"
+#include "input.h"
+
+static int rate = FRAME_RATE_DEFAULT;
+
+// Frame n is due at epoch_ms + n * 1000 / rate, so rates that do not divide
+// 1000 still average out exactly
+static uint64_t epoch_ms = 0;
+static uint64_t frame_index = 0;
+
+static uint64_t second_start_ms = 0;
+static int frames_this_second = 0;
+static int measured_rate = 0;
+
+static uint64_t due_ms() {
+    return epoch_ms + frame_index * 1000 / rate;
+}
+
+void frame_init(int r) {
+    if (!frame_set_rate(r)) frame_set_rate(FRAME_RATE_DEFAULT);
+    second_start_ms = epoch_ms;
+    frames_this_second = 0;
+    measured_rate = 0;
+}
+
+bool frame_set_rate(int r) {
+    if (r < FRAME_RATE_MIN || r > FRAME_RATE_MAX) return false;
+    rate = r;
+    epoch_ms = timer_ms();
+    frame_index = 1;
+    return true;
+}
+
+int frame_rate() {
+    return rate;
+}
+
+int frame_measured_rate() {
+    return measured_rate;
+}
+
+static void count_frame(uint64_t now) {
+    frames_this_second++;
+    if (now - second_start_ms >= 1000) {
+        measured_rate = frames_this_second;
+        frames_this_second = 0;
+        second_start_ms = now;
+    }
+}
+
+bool frame_wait() {
+    for (;;) {
+        uint64_t now = timer_ms();
+        if (now >= due_ms()) {
+            frame_index++;
+            // More than a frame behind (a long frame, or the debugger):
+            // restart the cadence instead of rendering a burst to catch up
+            if (now >= due_ms()) {
+                epoch_ms = now;
+                frame_index = 1;
+            }
+            count_frame(now);
+            return true;
+        }
+        // Keyboard and mouse interrupts end the hlt below as well
+        if (input_pending()) {
+            count_frame(now);
+            return false;
+        }
+        // Sleep until the next timer tick
+        asm volatile ("hlt");
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+
+#define FRAME_RATE_DEFAULT 60
+#define FRAME_RATE_MIN 10
+#define FRAME_RATE_MAX 240
+
+void frame_init(int rate);
+bool frame_set_rate(int rate);
+int frame_rate();
+
+// Sleep (hlt) until the next frame is due or PS/2 input has arrived.
+// Returns true if the frame is due, false if woken early by input.
+bool frame_wait();
+
+// Frames actually started over the last whole second
+int frame_measured_rate();
+
+#endif
@@ -0,0 +1,149 @@
+#include "glyph.h"
+#include "memory.h"
+#include "blit.h"
+
+typedef struct {
+    const font_t* font;
+    int scale;
+    uint32_t fg, bg;
+    uint32_t last_used;
+    size_t capacity; // pixels allocated
+    uint32_t* pixels;
+} glyph_slot_t;
+
+static glyph_slot_t slots[GLYPH_CACHE_SLOTS];
+static uint32_t use_clock = 0;
+static size_t cache_bytes = 0; // allocated across all slots
+
+static const font_t* font = NULL;
+static int scale = 1;
+
+static int font_glyphs(const font_t* f) {
+    return f->glyph_count < GLYPH_COUNT ? f->glyph_count : GLYPH_COUNT;
+}
+
+void glyph_init() {
+    for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        slots[i].pixels = NULL;
+        slots[i].capacity = 0;
+        slots[i].last_used = 0;
+    }
+    use_clock = 0;
+    cache_bytes = 0;
+    glyph_set_font(font_builtin(), 1);
+}
+
+bool glyph_set_font(const font_t* f, int s) {
+    if (!f || s < 1 || s > GLYPH_MAX_SCALE) return false;
+    font = f;
+    scale = s;
+    return true;
+}
+
+int glyph_width() {
+    return font->width * scale;
+}
+
+int glyph_height() {
+    return font->height * scale;
+}
+
+uint8_t glyph_index(char c) {
+    int idx = (unsigned char)c;
+    if (idx >= font_glyphs(font)) idx = '?';
+    return (uint8_t)idx;
+}
+
+static bool font_bit(const font_t* f, int index, int x, int y) {
+    const uint8_t* row = f->bitmap + (size_t)index * f->bytes_per_glyph + (size_t)y * f->bytes_per_row;
+    return (row[x >> 3] >> (7 - (x & 7))) & 1;
+}
+
+bool glyph_bit(uint8_t index, int x, int y) {
+    return font_bit(font, index, x / scale, y / scale);
+}
+
+// Each font row is expanded once, then repeated to fill its scaled rows
+static void expand_slot(glyph_slot_t* slot) {
+    const font_t* f = slot->font;
+    int s = slot->scale;
+    int w = f->width * s;
+    int count = font_glyphs(f);
+    uint32_t* out = slot->pixels;
+
+    for (int g = 0; g < count; g++) {
+        for (int row = 0; row < f->height; row++) {
+            uint32_t* line = out;
+            for (int col = 0; col < f->width; col++) {
+                uint32_t color = font_bit(f, g, col, row) ? slot->fg : slot->bg;
+                for (int k = 0; k < s; k++) *out++ = color;
+            }
+            for (int k = 1; k < s; k++) {
+                span_copy(out, line, w);
+                out += w;
+            }
+        }
+    }
+}
+
+static void free_slot(glyph_slot_t* slot) {
+    if (!slot->pixels) return;
+    free(slot->pixels);
+    cache_bytes -= slot->capacity * sizeof(uint32_t);
+    slot->pixels = NULL;
+    slot->capacity = 0;
+}
+
+// Least recently used slot holding an atlas, or NULL if all are empty
+static glyph_slot_t* oldest_slot() {
+    glyph_slot_t* oldest = NULL;
+    for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        glyph_slot_t* slot = &slots[i];
+        if (slot->pixels && (!oldest || slot->last_used < oldest->last_used)) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+const uint32_t* glyph_set(uint32_t fg, uint32_t bg) {
+    use_clock++;
+
+    // Hit, or remember the least recently used slot for eviction
+    glyph_slot_t* victim = &slots[0];
+    for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        glyph_slot_t* slot = &slots[i];
+        if (slot->pixels && slot->font == font && slot->scale == scale &&
+            slot->fg == fg && slot->bg == bg) {
+            slot->last_used = use_clock;
+            return slot->pixels;
+        }
+        if (!slot->pixels) {
+            if (victim->pixels) victim = slot;
+        } else if (victim->pixels && slot->last_used < victim->last_used) {
+            victim = slot;
+        }
+    }
+
+    size_t needed = (size_t)font_glyphs(font) * glyph_width() * glyph_height();
+    size_t bytes = needed * sizeof(uint32_t);
+    if (bytes > GLYPH_CACHE_BUDGET) return NULL;
+    if (victim->capacity < needed) {
+        free_slot(victim);
+        // Evict the oldest atlases until the new one fits the budget
+        while (cache_bytes + bytes > GLYPH_CACHE_BUDGET) {
+            free_slot(oldest_slot());
+        }
+        victim->pixels = (uint32_t*)malloc(bytes);
+        if (!victim->pixels) return NULL;
+        victim->capacity = needed;
+        cache_bytes += bytes;
+    }
+    victim->font = font;
+    victim->scale = scale;
+    victim->fg = fg;
+    victim->bg = bg;
+    victim->last_used = use_clock;
+    expand_slot(victim);
+    return victim->pixels;
+}
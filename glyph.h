@@ -0,0 +1,43 @@
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "psf.h"
+
+// Characters are bytes, so at most this many glyphs of a font are reachable
+#define GLYPH_COUNT 256
+
+// Glyphs are pre-scaled into the atlas by an integer factor up to this
+#define GLYPH_MAX_SCALE 4
+
+// Number of atlases (font, scale, foreground, background) kept expanded at once
+#define GLYPH_CACHE_SLOTS 8
+
+// Bytes all cached atlases may take together; older atlases are evicted to
+// stay under it, and a single atlas larger than this is never cached
+#define GLYPH_CACHE_BUDGET (16 * 1024 * 1024)
+
+void glyph_init();
+
+// Select the font and integer scale used by text drawing
+bool glyph_set_font(const font_t* font, int scale);
+
+// Cell size of the selected font after scaling, in pixels
+int glyph_width();
+int glyph_height();
+
+uint8_t glyph_index(char c);
+
+// Atlas of the selected font at the selected scale, pre-expanded to 32-bit
+// pixels for one color pair. Glyphs are packed one after another, each
+// glyph_height() rows of glyph_width() pixels. NULL if out of memory or
+// the atlas alone exceeds GLYPH_CACHE_BUDGET.
+// An atlas for (0xFFFFFFFF, 0) holds per-pixel masks for transparent text.
+const uint32_t* glyph_set(uint32_t fg, uint32_t bg);
+
+// Whether a pixel of a glyph is set, in scaled cell coordinates; slow path
+// for when no atlas can be allocated
+bool glyph_bit(uint8_t index, int x, int y);
+
+#endif
@@ -1,101 +1,619 @@
 #include "graphics.h"
+#include "memory.h"
+#include "blit.h"
+#include "glyph.h"
+#include "scanout.h"
+#include "timer.h"
 
 static struct limine_framebuffer *fb = NULL;
+static const scanout_format_t* format = NULL;
+static size_t fb_bytes_per_pixel = 4;
+
+// Everything is drawn into `screen`. Normally that is a RAM back buffer which
+// graphics_present() copies to the framebuffer; if the back buffer could not be
+// allocated it aliases the framebuffer itself and presenting is a no-op.
+static surface_t screen;
+static bool has_back_buffer = false;
+
+// Where the drawing primitives write: `screen`, or an off-screen surface picked
+// with graphics_set_target() (e.g. a window's backing store)
+static surface_t* target = &screen;
+
+// Pre-rendered desktop gradient, see render_wallpaper()
+static surface_t wallpaper;
+
+static rect_t dirty_rects[MAX_DIRTY_RECTS];
+static int dirty_count = 0;
+
+// Drawing primitives only touch pixels inside this rectangle (the whole screen
+// unless graphics_set_clip() narrowed it)
+static rect_t clip;
+
+static void render_wallpaper();
+
+// Integer factor applied to the 800x600 layout, chosen from the mode size
+static int ui_scale = 1;
+
+// Pointer sprite, pre-rendered at the UI scale and layered over the back buffer
+// at present time. Pixels with zero alpha are see-through.
+static uint32_t cursor_sprite[CURSOR_WIDTH * UI_MAX_SCALE * CURSOR_HEIGHT * UI_MAX_SCALE];
+static int cursor_w = CURSOR_WIDTH, cursor_h = CURSOR_HEIGHT;
+static int cursor_x = 0, cursor_y = 0;
+static int shown_x = 0, shown_y = 0;
+static bool cursor_requested = false;
+static bool cursor_shown = false;
+
+static present_stats_t present_stats;
+
+static void render_cursor_sprite();
 
 void init_graphics(struct limine_framebuffer *framebuffer) {
+    blit_init();
+    glyph_init();
+
+    // Pick the scanout routine for this framebuffer's pixel layout once, up front
+    format = scanout_select(framebuffer);
+    if (!format) return; // Not a layout we can drive; leave graphics disabled
+    fb_bytes_per_pixel = (framebuffer->bpp + 7) / 8;
+
+    // 1x up to 1080p, 2x at 1440p, 3x at 4K
+    int sx = framebuffer->width / 1280, sy = framebuffer->height / 720;
+    ui_scale = sx < sy ? sx : sy;
+    if (ui_scale < 1) ui_scale = 1;
+    if (ui_scale > UI_MAX_SCALE) ui_scale = UI_MAX_SCALE;
+    render_cursor_sprite();
+
+    screen.width = framebuffer->width;
+    screen.height = framebuffer->height;
+    screen.pitch = framebuffer->width;
+    screen.pixels = (uint32_t*)malloc((size_t)screen.width * screen.height * sizeof(uint32_t));
+    has_back_buffer = screen.pixels != NULL;
+
+    if (!has_back_buffer) {
+        // Out of heap: fall back to drawing straight to the framebuffer, which is
+        // only possible when it already uses the back buffer's xRGB layout
+        if (!scanout_is_native(format)) return;
+        screen.pixels = (uint32_t*)framebuffer->address;
+        screen.pitch = framebuffer->pitch / 4;
+    }
     fb = framebuffer;
+    dirty_count = 0;
+    graphics_reset_clip();
+
+    wallpaper.pixels = NULL;
+    render_wallpaper();
 }
 
-void put_pixel(int x, int y, uint32_t color) {
+bool graphics_has_back_buffer() {
+    return has_back_buffer;
+}
+
+int graphics_ui_scale() {
+    return ui_scale;
+}
+
+int ui_px(int px) {
+    return px * ui_scale;
+}
+
+// Clip a rectangle against `bounds`; returns false if nothing is left
+static bool clip_to(rect_t bounds, int* x, int* y, int* w, int* h) {
+    if (*x < bounds.x) { *w -= bounds.x - *x; *x = bounds.x; }
+    if (*y < bounds.y) { *h -= bounds.y - *y; *y = bounds.y; }
+    if (*x + *w > bounds.x + bounds.width) *w = bounds.x + bounds.width - *x;
+    if (*y + *h > bounds.y + bounds.height) *h = bounds.y + bounds.height - *y;
+    return *w > 0 && *h > 0;
+}
+
+static bool clip_to_screen(int* x, int* y, int* w, int* h) {
+    rect_t bounds = { 0, 0, screen.width, screen.height };
+    return clip_to(bounds, x, y, w, h);
+}
+
+static bool clip_to_target(int* x, int* y, int* w, int* h) {
+    rect_t bounds = { 0, 0, target->width, target->height };
+    return clip_to(bounds, x, y, w, h);
+}
+
+// Clip a rectangle against the current clip rect, for everything that draws
+static bool clip_rect(int* x, int* y, int* w, int* h) {
+    return clip_to(clip, x, y, w, h);
+}
+
+void graphics_set_clip(int x, int y, int width, int height) {
+    if (!clip_to_target(&x, &y, &width, &height)) {
+        width = 0;
+        height = 0;
+    }
+    clip.x = x;
+    clip.y = y;
+    clip.width = width;
+    clip.height = height;
+}
+
+void graphics_reset_clip() {
+    clip.x = 0;
+    clip.y = 0;
+    clip.width = target->width;
+    clip.height = target->height;
+}
+
+void graphics_set_target(surface_t* surface) {
+    target = (surface && surface->pixels) ? surface : &screen;
+    graphics_reset_clip();
+}
+
+static long rect_area(rect_t r) {
+    return (long)r.width * r.height;
+}
+
+static rect_t rect_union(rect_t a, rect_t b) {
+    rect_t u;
+    u.x = a.x < b.x ? a.x : b.x;
+    u.y = a.y < b.y ? a.y : b.y;
+    int right = (a.x + a.width > b.x + b.width) ? a.x + a.width : b.x + b.width;
+    int bottom = (a.y + a.height > b.y + b.height) ? a.y + a.height : b.y + b.height;
+    u.width = right - u.x;
+    u.height = bottom - u.y;
+    return u;
+}
+
+static void dirty_add(rect_t r) {
+    // Fold into an existing rect when the union wastes (almost) no area; this also
+    // swallows rects that are contained in, or overlap heavily with, existing damage
+    for (int i = 0; i < dirty_count; i++) {
+        rect_t u = rect_union(dirty_rects[i], r);
+        if (rect_area(u) <= rect_area(dirty_rects[i]) + rect_area(r)) {
+            dirty_rects[i] = dirty_rects[--dirty_count];
+            dirty_add(u);
+            return;
+        }
+    }
+
+    if (dirty_count == MAX_DIRTY_RECTS) {
+        // List full: merge with whichever rect grows the least
+        int best = 0;
+        long best_growth = -1;
+        for (int i = 0; i < dirty_count; i++) {
+            long growth = rect_area(rect_union(dirty_rects[i], r)) - rect_area(dirty_rects[i]);
+            if (best_growth < 0 || growth < best_growth) {
+                best_growth = growth;
+                best = i;
+            }
+        }
+        rect_t u = rect_union(dirty_rects[best], r);
+        dirty_rects[best] = dirty_rects[--dirty_count];
+        dirty_add(u);
+        return;
+    }
+
+    dirty_rects[dirty_count++] = r;
+}
+
+void graphics_mark_dirty(int x, int y, int width, int height) {
+    if (!has_back_buffer || target != &screen) return;
+    if (!clip_to_screen(&x, &y, &width, &height)) return;
+    rect_t r = { x, y, width, height };
+    dirty_add(r);
+}
+
+void graphics_invalidate() {
+    if (!has_back_buffer) return;
+    dirty_rects[0].x = 0;
+    dirty_rects[0].y = 0;
+    dirty_rects[0].width = screen.width;
+    dirty_rects[0].height = screen.height;
+    dirty_count = 1;
+}
+
+// Unchecked store into the draw target; callers clip and mark damage themselves
+static inline void plot(int x, int y, uint32_t color) {
+    target->pixels[(size_t)y * target->pitch + x] = color;
+}
+
+// Simple arrow cursor (10x16 pixels), scaled up once here rather than per frame
+static void render_cursor_sprite() {
+    cursor_w = CURSOR_WIDTH * ui_scale;
+    cursor_h = CURSOR_HEIGHT * ui_scale;
+    for (int y = 0; y < cursor_h; y++) {
+        for (int x = 0; x < cursor_w; x++) {
+            int col = x / ui_scale, row = y / ui_scale;
+            uint32_t color = COLOR_TRANSPARENT;
+            if (col < CURSOR_WIDTH - (row / 2)) {
+                color = (col < 2 || row < 2) ? COLOR_WHITE : COLOR_BLACK;
+            }
+            cursor_sprite[y * cursor_w + x] = color;
+        }
+    }
+}
+
+// Send the cursor-sized cell at (x, y) to the framebuffer: the scene from the
+// back buffer, with the arrow composed on top if `with_sprite`.
+// The back buffer never contains the cursor, so it doubles as the save-under.
+static void cursor_send(int x, int y, bool with_sprite) {
+    int cx = x, cy = y, w = cursor_w, h = cursor_h;
+    if (!clip_to_screen(&cx, &cy, &w, &h)) return;
+
+    uint8_t* fb_base = (uint8_t*)fb->address;
+    uint32_t row_buf[CURSOR_WIDTH * UI_MAX_SCALE];
+    for (int row = cy; row < cy + h; row++) {
+        const uint32_t* scene = screen.pixels + (size_t)row * screen.pitch + cx;
+        const uint32_t* sprite = cursor_sprite + (size_t)(row - y) * cursor_w + (cx - x);
+        for (int col = 0; col < w; col++) {
+            row_buf[col] = (with_sprite && (sprite[col] >> 24)) ? sprite[col] : scene[col];
+        }
+        format->convert(fb_base + (size_t)row * fb->pitch + (size_t)cx * fb_bytes_per_pixel, row_buf, w);
+    }
+}
+
+static bool rects_intersect(rect_t r, int x, int y, int w, int h) {
+    return r.x < x + w && x < r.x + r.width && r.y < y + h && y < r.y + r.height;
+}
+
+// Move the pointer sprite; takes effect at the next graphics_present()
+void graphics_set_cursor(int x, int y) {
+    cursor_x = x;
+    cursor_y = y;
+    cursor_requested = true;
+}
+
+// Without a back buffer there is nothing to restore from: draw the arrow into
+// the scene, as the next frame's redraw is what erases it
+static void cursor_draw_direct() {
+    for (int row = 0; row < cursor_h; row++) {
+        for (int col = 0; col < cursor_w; col++) {
+            int px = cursor_x + col, py = cursor_y + row;
+            if (px < 0 || px >= screen.width || py < 0 || py >= screen.height) continue;
+            uint32_t color = cursor_sprite[row * cursor_w + col];
+            if (color >> 24) plot(px, py, color);
+        }
+    }
+}
+
+// Copy the accumulated damage to the framebuffer, once per frame, converting to
+// the framebuffer's pixel format on the way out. The cursor is layered on last.
+void graphics_present() {
     if (!fb) return;
-    if (x < 0 || x >= (int)fb->width || y < 0 || y >= (int)fb->height) return;
+    if (!has_back_buffer) {
+        if (cursor_requested) cursor_draw_direct();
+        return;
+    }
+
+    bool cursor_moved = cursor_requested &&
+        (!cursor_shown || cursor_x != shown_x || cursor_y != shown_y);
+    bool cursor_damaged = false;
+    uint64_t start = rdtsc();
+    uint32_t pixels = 0;
+
+    uint8_t* fb_base = (uint8_t*)fb->address;
+    for (int i = 0; i < dirty_count; i++) {
+        rect_t r = dirty_rects[i];
+        pixels += (uint32_t)(r.width * r.height);
+        if (cursor_requested && rects_intersect(r, cursor_x, cursor_y, cursor_w, cursor_h)) {
+            cursor_damaged = true;
+        }
+        for (int row = 0; row < r.height; row++) {
+            uint32_t* src = screen.pixels + (size_t)(r.y + row) * screen.pitch + r.x;
+            uint8_t* dst = fb_base + (size_t)(r.y + row) * fb->pitch + (size_t)r.x * fb_bytes_per_pixel;
+            format->convert(dst, src, r.width);
+        }
+    }
+
+    // Pointer motion touches two small cells: the old one goes back to the
+    // scene, the new one gets the sprite. Nothing else needs redrawing.
+    if (cursor_moved && cursor_shown) {
+        cursor_send(shown_x, shown_y, false);
+    }
+    if (cursor_moved || cursor_damaged) {
+        cursor_send(cursor_x, cursor_y, true);
+        shown_x = cursor_x;
+        shown_y = cursor_y;
+        cursor_shown = true;
+    }
+
+    blit_stream_fence();
+    dirty_count = 0;
 
-    // Assuming 32-bit color (4 bytes per pixel)
-    uint32_t *fb_ptr = (uint32_t*)fb->address;
-    size_t index = y * (fb->pitch / 4) + x;
-    fb_ptr[index] = color;
+    present_stats.frames++;
+    present_stats.pixels = pixels;
+    present_stats.cycles = rdtsc() - start;
+    if (present_stats.cycles > present_stats.peak_cycles) {
+        present_stats.peak_cycles = present_stats.cycles;
+    }
+}
+
+const present_stats_t* graphics_present_stats() {
+    return &present_stats;
 }
 
-#include "font.h"
+void put_pixel(int x, int y, uint32_t color) {
+    if (!fb) return;
+    if (x < clip.x || x >= clip.x + clip.width || y < clip.y || y >= clip.y + clip.height) return;
+
+    plot(x, y, color);
+    graphics_mark_dirty(x, y, 1, 1);
+}
 
 void draw_rect(int x, int y, int width, int height, uint32_t color) {
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            put_pixel(x + j, y + i, color);
+    if (!fb) return;
+    if ((color >> 24) != 0xFF) {
+        // Palette colors with alpha (shadows, dock) are composited, not stored
+        draw_rect_blend(x, y, width, height, color);
+        return;
+    }
+    if (!clip_rect(&x, &y, &width, &height)) return;
+
+    uint32_t* row = target->pixels + (size_t)y * target->pitch + x;
+    if ((size_t)width * height >= BLIT_STREAM_THRESHOLD) {
+        // Large fills (backgrounds, full-screen clears) would only thrash the cache
+        for (int i = 0; i < height; i++, row += target->pitch) {
+            span_fill_stream(row, color, width);
+        }
+        blit_stream_fence();
+    } else {
+        for (int i = 0; i < height; i++, row += target->pitch) {
+            span_fill(row, color, width);
         }
     }
+    graphics_mark_dirty(x, y, width, height);
 }
 
-void draw_char(int x, int y, char c, uint32_t color) {
+// Blend `color` over the back buffer using its alpha byte
+void draw_rect_blend(int x, int y, int width, int height, uint32_t color) {
     if (!fb) return;
-    int idx = (unsigned char)c;
-    if (idx > 127) idx = 127;
-
-    for (int row = 0; row < 8; row++) {
-        uint8_t line = font8x8_basic[idx][row];
-        for (int col = 0; col < 8; col++) {
-            // Check if bit (7-col) is set
-            if ((line >> (7 - col)) & 1) {
-                // Scale by 1 (or 2 for bigger font)
-                put_pixel(x + col, y + row, color);
+    if ((color >> 24) == 0) return;
+    if (!clip_rect(&x, &y, &width, &height)) return;
+
+    uint32_t* row = target->pixels + (size_t)y * target->pitch + x;
+    for (int i = 0; i < height; i++, row += target->pitch) {
+        span_blend(row, color, width);
+    }
+    graphics_mark_dirty(x, y, width, height);
+}
+
+// Clip a blit against both the source surface and the screen, keeping the two
+// origins in step. Returns false if nothing is left to copy.
+static bool clip_blit(int* x, int* y, surface_t* src, int* sx, int* sy, int* width, int* height) {
+    if (*sx < 0) { *x -= *sx; *width += *sx; *sx = 0; }
+    if (*sy < 0) { *y -= *sy; *height += *sy; *sy = 0; }
+    if (*sx + *width > src->width) *width = src->width - *sx;
+    if (*sy + *height > src->height) *height = src->height - *sy;
+
+    int cx = *x, cy = *y;
+    if (!clip_rect(&cx, &cy, width, height)) return false;
+    *sx += cx - *x;
+    *sy += cy - *y;
+    *x = cx;
+    *y = cy;
+    return true;
+}
+
+// Copy a w*h block of `src` starting at (sx, sy) onto the screen at (x, y)
+void blit_rect(int x, int y, surface_t* src, int sx, int sy, int width, int height) {
+    if (!fb || !src || !src->pixels) return;
+    if (!clip_blit(&x, &y, src, &sx, &sy, &width, &height)) return;
+
+    uint32_t* dst_row = target->pixels + (size_t)y * target->pitch + x;
+    const uint32_t* src_row = src->pixels + (size_t)sy * src->pitch + sx;
+    for (int i = 0; i < height; i++) {
+        span_copy(dst_row, src_row, width);
+        dst_row += target->pitch;
+        src_row += src->pitch;
+    }
+    graphics_mark_dirty(x, y, width, height);
+}
+
+// Like blit_rect, but composites each source pixel by its own alpha
+void blit_rect_blend(int x, int y, surface_t* src, int sx, int sy, int width, int height) {
+    if (!fb || !src || !src->pixels) return;
+    if (!clip_blit(&x, &y, src, &sx, &sy, &width, &height)) return;
+
+    uint32_t* dst_row = target->pixels + (size_t)y * target->pitch + x;
+    const uint32_t* src_row = src->pixels + (size_t)sy * src->pitch + sx;
+    for (int i = 0; i < height; i++) {
+        span_blend_copy(dst_row, src_row, width);
+        dst_row += target->pitch;
+        src_row += src->pitch;
+    }
+    graphics_mark_dirty(x, y, width, height);
+}
+
+// Move a block of the screen to (dx, dy); overlapping source and destination are fine
+void copy_rect(int sx, int sy, int dx, int dy, int width, int height) {
+    if (!fb) return;
+
+    int cx = sx, cy = sy;
+    if (!clip_to_target(&cx, &cy, &width, &height)) return;
+    dx += cx - sx;
+    dy += cy - sy;
+    sx = cx;
+    sy = cy;
+
+    cx = dx, cy = dy;
+    if (!clip_rect(&cx, &cy, &width, &height)) return;
+    sx += cx - dx;
+    sy += cy - dy;
+    dx = cx;
+    dy = cy;
+
+    // Walk rows bottom-up when moving down so we never read a row already overwritten
+    if (dy > sy) {
+        for (int i = height - 1; i >= 0; i--) {
+            span_move(target->pixels + (size_t)(dy + i) * target->pitch + dx,
+                      target->pixels + (size_t)(sy + i) * target->pitch + sx, width);
+        }
+    } else {
+        for (int i = 0; i < height; i++) {
+            span_move(target->pixels + (size_t)(dy + i) * target->pitch + dx,
+                      target->pixels + (size_t)(sy + i) * target->pitch + sx, width);
+        }
+    }
+    graphics_mark_dirty(dx, dy, width, height);
+}
+
+// Draw `len` characters of `str` (or up to the terminator if len < 0) on one line.
+// The run is clipped once; every glyph row is then copied from the glyph atlas.
+// A background with zero alpha (COLOR_TRANSPARENT) leaves the pixels behind the text alone.
+void draw_text_run(int x, int y, const char* str, int len, uint32_t fg, uint32_t bg) {
+    if (!fb || !str) return;
+    if (len < 0) {
+        len = 0;
+        while (str[len]) len++;
+    }
+    if (len == 0) return;
+
+    int gw = glyph_width();
+    int gh = glyph_height();
+    int row0 = y < clip.y ? clip.y - y : 0;
+    int row1 = (y + gh > clip.y + clip.height) ? clip.y + clip.height - y : gh;
+    int vx0 = x < clip.x ? clip.x : x;
+    int vx1 = x + len * gw;
+    if (vx1 > clip.x + clip.width) vx1 = clip.x + clip.width;
+    if (row0 >= row1 || vx0 >= vx1) return;
+
+    // Opaque text copies glyph pixels; transparent text combines through a mask atlas
+    bool opaque = (bg >> 24) != 0;
+    const uint32_t* atlas = opaque ? glyph_set(fg, bg) : glyph_set(0xFFFFFFFF, 0);
+    if (opaque && !atlas) {
+        // Atlas allocation failed: paint the background, then the set pixels
+        draw_rect(vx0, y + row0, vx1 - vx0, row1 - row0, bg);
+    }
+    size_t glyph_pixels = (size_t)gw * gh;
+
+    for (int row = row0; row < row1; row++) {
+        uint32_t* dst_row = target->pixels + (size_t)(y + row) * target->pitch;
+        int px = vx0;
+        while (px < vx1) {
+            int i = (px - x) / gw;
+            int col0 = (px - x) % gw;
+            int ncols = gw - col0;
+            if (ncols > vx1 - px) ncols = vx1 - px;
+
+            uint8_t idx = glyph_index(str[i]);
+            uint32_t* dst = dst_row + px;
+            if (atlas) {
+                const uint32_t* src = atlas + idx * glyph_pixels + (size_t)row * gw + col0;
+                if (opaque) {
+                    span_copy(dst, src, ncols);
+                } else {
+                    for (int c = 0; c < ncols; c++) {
+                        dst[c] = (dst[c] & ~src[c]) | (fg & src[c]);
+                    }
+                }
+            } else {
+                for (int c = 0; c < ncols; c++) {
+                    if (glyph_bit(idx, col0 + c, row)) dst[c] = fg;
+                }
             }
+            px += ncols;
         }
     }
+    graphics_mark_dirty(vx0, y + row0, vx1 - vx0, row1 - row0);
+}
+
+void draw_char(int x, int y, char c, uint32_t color) {
+    draw_text_run(x, y, &c, 1, color, COLOR_TRANSPARENT);
 }
 
 void draw_string(int x, int y, char* str, uint32_t color) {
-    int cur_x = x;
-    while (*str) {
-        draw_char(cur_x, y, *str, color);
-        cur_x += 8; // Move 8 pixels to the right
-        str++;
+    draw_text_run(x, y, str, -1, color, COLOR_TRANSPARENT);
+}
+
+// Big Sur gradient: Soft pink/purple at top, deep blue/purple at bottom
+// Top: Soft pink (255, 200, 220) -> Bottom: Deep purple/blue (100, 100, 200)
+static uint32_t gradient_pixel(int x, int y) {
+    uint32_t ny_val = ((uint32_t)y * 255) / screen.height;
+    uint32_t nx_val = ((uint32_t)x * 255) / screen.width;
+
+    uint8_t r = (uint8_t)(255 - (ny_val * 155) / 255 + (nx_val * 20) / 255);
+    uint8_t g = (uint8_t)(200 - (ny_val * 100) / 255);
+    uint8_t b = (uint8_t)(220 - (ny_val * 20) / 255 + (nx_val * 35) / 255);
+    return (0xFFu << 24) | (r << 16) | (g << 8) | b;
+}
+
+// Render the wallpaper once into its own surface. Each channel of the gradient is
+// a per-row term plus a per-column term, so the divisions go into two small column
+// tables and three values per row instead of being redone for every pixel.
+static void render_wallpaper() {
+    int w = screen.width, h = screen.height;
+    size_t pixel_bytes = (size_t)w * h * sizeof(uint32_t);
+
+    // Column tables ride along at the end of the same allocation
+    wallpaper.pixels = (uint32_t*)malloc(pixel_bytes + 2 * (size_t)w);
+    if (!wallpaper.pixels) return;
+    wallpaper.width = w;
+    wallpaper.height = h;
+    wallpaper.pitch = w;
+
+    uint8_t* col_r = (uint8_t*)wallpaper.pixels + pixel_bytes;
+    uint8_t* col_b = col_r + w;
+    for (int x = 0; x < w; x++) {
+        uint32_t nx_val = ((uint32_t)x * 255) / w;
+        col_r[x] = (uint8_t)((nx_val * 20) / 255);
+        col_b[x] = (uint8_t)((nx_val * 35) / 255);
+    }
+
+    uint32_t* row = wallpaper.pixels;
+    for (int y = 0; y < h; y++, row += wallpaper.pitch) {
+        uint32_t ny_val = ((uint32_t)y * 255) / h;
+        uint32_t row_r = 255 - (ny_val * 155) / 255;
+        uint32_t row_g = 200 - (ny_val * 100) / 255;
+        uint32_t row_b = 220 - (ny_val * 20) / 255;
+        uint32_t base = (0xFFu << 24) | (row_g << 8);
+        for (int x = 0; x < w; x++) {
+            uint8_t r = (uint8_t)(row_r + col_r[x]);
+            uint8_t b = (uint8_t)(row_b + col_b[x]);
+            row[x] = base | ((uint32_t)r << 16) | b;
+        }
     }
 }
 
-// Draw a macOS Big Sur-style gradient background
-void draw_desktop_background() {
+// Repaint part of the desktop wallpaper, e.g. where a window used to be
+void draw_desktop_region(int x, int y, int width, int height) {
     if (!fb) return;
-    uint32_t *fb_ptr = (uint32_t*)fb->address;
-    
-    for (size_t y = 0; y < fb->height; y++) {
-        for (size_t x = 0; x < fb->width; x++) {
-            // Big Sur gradient: Soft pink/purple at top, deep blue/purple at bottom
-            // Using integer math for smooth transitions
-            uint32_t ny_val = (y * 255) / fb->height;
-            uint32_t nx_val = (x * 255) / fb->width;
-            
-            // Top: Soft pink (255, 200, 220) -> Bottom: Deep purple/blue (100, 100, 200)
-            uint8_t r = (uint8_t)(255 - (ny_val * 155) / 255 + (nx_val * 20) / 255);
-            uint8_t g = (uint8_t)(200 - (ny_val * 100) / 255);
-            uint8_t b = (uint8_t)(220 - (ny_val * 20) / 255 + (nx_val * 35) / 255);
-            
-            size_t index = y * (fb->pitch / 4) + x;
-            fb_ptr[index] = (0xFF << 24) | (r << 16) | (g << 8) | b;
+    if (wallpaper.pixels) {
+        blit_rect(x, y, &wallpaper, x, y, width, height);
+        return;
+    }
+
+    // No cached surface (out of heap): compute the gradient directly
+    if (!clip_rect(&x, &y, &width, &height)) return;
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            plot(x + j, y + i, gradient_pixel(x + j, y + i));
         }
     }
+    graphics_mark_dirty(x, y, width, height);
+}
+
+// Draw a macOS Big Sur-style gradient background
+void draw_desktop_background() {
+    draw_desktop_region(0, 0, screen.width, screen.height);
 }
 
 void draw_top_bar(char* time_str) {
     if (!fb) return;
+    int height = ui_px(TOPBAR_HEIGHT);
+
     // Subtle light gray background
-    draw_rect(0, 0, fb->width, 28, COLOR_TOPBAR);
+    draw_rect(0, 0, screen.width, height, COLOR_TOPBAR);
     
     // Apple logo placeholder (refined black square)
-    draw_rect(16, 6, 16, 16, COLOR_BLACK);
+    draw_rect(ui_px(16), ui_px(6), ui_px(16), ui_px(16), COLOR_BLACK);
     
-    // Draw time on the right side with proper spacing
+    // Draw time on the right side with proper spacing, centered vertically
     if (time_str) {
-        int time_x = fb->width - 70;
-        draw_string(time_x, 8, time_str, COLOR_TOPBAR_TEXT);
+        int time_x = screen.width - ui_px(70);
+        draw_string(time_x, (height - glyph_height()) / 2, time_str, COLOR_TOPBAR_TEXT);
     }
 }
 
 void draw_dock() {
     if (!fb) return;
-    int dock_width = 400;
-    int dock_height = 70;
-    int dock_x = (fb->width - dock_width) / 2;
-    int dock_y = fb->height - dock_height - 16;
+    int dock_width = ui_px(400);
+    int dock_height = ui_px(70);
+    int dock_x = (screen.width - dock_width) / 2;
+    int dock_y = screen.height - dock_height - ui_px(16);
 
     // Refined dock background with subtle transparency simulation
     draw_rect(dock_x, dock_y, dock_width, dock_height, COLOR_DOCK_BG);
@@ -104,10 +622,10 @@ void draw_dock() {
     draw_rect(dock_x, dock_y, dock_width, 1, COLOR_DOCK_BORDER);
 
     // Icons with proper spacing (8px grid)
-    int icon_size = 48;
-    int gap = 16;
-    int start_x = dock_x + 24;
-    int start_y = dock_y + 11;
+    int icon_size = ui_px(48);
+    int gap = ui_px(16);
+    int start_x = dock_x + ui_px(24);
+    int start_y = dock_y + ui_px(11);
 
     // Finder (Blue)
     draw_rect(start_x, start_y, icon_size, icon_size, COLOR_FINDER);
@@ -122,45 +640,100 @@ void draw_dock() {
     draw_rect(start_x + (icon_size + gap) * 3, start_y, icon_size, icon_size, COLOR_SETTINGS);
 }
 
-void draw_window(int x, int y, int width, int height, char* title) {
-    // Multi-layer shadow for depth (Apple-style)
+// Blend the border of a rectangle, `thickness` pixels wide, leaving its inside alone
+static void blend_ring(int x, int y, int width, int height, int thickness, uint32_t color) {
+    draw_rect_blend(x, y, width, thickness, color);
+    draw_rect_blend(x, y + height - thickness, width, thickness, color);
+    draw_rect_blend(x, y + thickness, thickness, height - 2 * thickness, color);
+    draw_rect_blend(x + width - thickness, y + thickness, thickness, height - 2 * thickness, color);
+}
+
+// Multi-layer shadow for depth (Apple-style). Only the rings outside the window
+// are blended; the window itself is opaque and covers the inside.
+void draw_window_shadow(int x, int y, int width, int height) {
     // Ambient shadow (larger, softer)
-    draw_rect(x - 4, y - 4, width + 8, height + 8, COLOR_SHADOW_AMBIENT);
+    int ambient = ui_px(4), direct = ui_px(2);
+    blend_ring(x - ambient, y - ambient, width + 2 * ambient, height + 2 * ambient, ambient, COLOR_SHADOW_AMBIENT);
     // Direct shadow (smaller, sharper)
-    draw_rect(x - 2, y - 2, width + 4, height + 4, COLOR_SHADOW_DIRECT);
+    blend_ring(x - direct, y - direct, width + 2 * direct, height + 2 * direct, direct, COLOR_SHADOW_DIRECT);
+}
 
+// Window frame: body, title bar, traffic lights and title. The shadow is separate
+// so a frame can be drawn into an off-screen surface.
+void draw_window(int x, int y, int width, int height, char* title) {
     // Main Window Body (pure white)
     draw_rect(x, y, width, height, COLOR_WINDOW_BG);
 
     // Title Bar (subtle gray)
-    int title_bar_height = 28;
+    int title_bar_height = ui_px(28);
     draw_rect(x, y, width, title_bar_height, COLOR_WINDOW_TITLE);
 
     // Traffic Lights with proper macOS spacing and colors
-    int btn_y = y + 7;
-    int btn_size = 12;
-    draw_rect(x + 12, btn_y, btn_size, btn_size, 0xFFFF5F56); // Close (Red)
-    draw_rect(x + 32, btn_y, btn_size, btn_size, 0xFFFFBD2E); // Minimize (Yellow)
-    draw_rect(x + 52, btn_y, btn_size, btn_size, 0xFF27C93F); // Maximize (Green)
+    int btn_y = y + ui_px(7);
+    int btn_size = ui_px(12);
+    draw_rect(x + ui_px(12), btn_y, btn_size, btn_size, 0xFFFF5F56); // Close (Red)
+    draw_rect(x + ui_px(32), btn_y, btn_size, btn_size, 0xFFFFBD2E); // Minimize (Yellow)
+    draw_rect(x + ui_px(52), btn_y, btn_size, btn_size, 0xFF27C93F); // Maximize (Green)
 
     // Title text (centered in title bar)
     if (title) {
-        draw_string(x + 80, y + 8, title, COLOR_TEXT_PRIMARY);
+        draw_string(x + ui_px(80), y + (title_bar_height - glyph_height()) / 2, title, COLOR_TEXT_PRIMARY);
     }
 
     // Window Content Placeholder (subtle background)
     draw_rect(x + 1, y + title_bar_height, width - 2, height - title_bar_height - 1, 0xFFFAFAFA);
 }
 
-void draw_cursor(int x, int y) {
-    // Simple arrow cursor (10x16 pixels)
-    for (int i = 0; i < 16; i++) {
-        for (int j = 0; j < 10 - (i / 2); j++) {
-            if (j < 2 || i < 2) {
-                put_pixel(x + j, y + i, COLOR_WHITE);
-            } else {
-                put_pixel(x + j, y + i, COLOR_BLACK);
-            }
+// Affects text drawn from now on; callers redraw whatever text they own
+bool graphics_set_font(const font_t* font, int scale) {
+    return glyph_set_font(font, scale);
+}
+
+int graphics_char_width() {
+    return glyph_width();
+}
+
+int graphics_char_height() {
+    return glyph_height();
+}
+
+int graphics_width() {
+    return fb ? screen.width : 0;
+}
+
+int graphics_height() {
+    return fb ? screen.height : 0;
+}
+
+const char* graphics_format_name() {
+    return format ? format->name : "none";
+}
+
+// Write-bandwidth self-test: stream-fill the raw framebuffer a few times and time it.
+// The screen is repainted from the back buffer on the next present.
+uint32_t graphics_measure_fill_mbps() {
+    if (!fb || timer_tsc_hz() == 0) return 0;
+
+    // Only the visible bytes of each row, whatever the pixel size; zero is
+    // black in every format
+    const int passes = 4;
+    size_t row_bytes = (size_t)fb->width * fb_bytes_per_pixel;
+    size_t words_per_row = row_bytes / 4;
+    uint8_t* base = (uint8_t*)fb->address;
+
+    uint64_t start = rdtsc();
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t y = 0; y < fb->height; y++) {
+            uint8_t* row = base + y * fb->pitch;
+            span_fill_stream((uint32_t*)row, 0, words_per_row);
+            for (size_t i = words_per_row * 4; i < row_bytes; i++) row[i] = 0;
         }
     }
+    blit_stream_fence();
+    uint64_t cycles = rdtsc() - start;
+
+    graphics_invalidate();
+    if (cycles == 0) return 0;
+    uint64_t bytes = (uint64_t)row_bytes * fb->height * passes;
+    return (uint32_t)(bytes * (timer_tsc_hz() / 1000) / cycles / 1000);
 }
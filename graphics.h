@@ -3,14 +3,16 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "limine.h"
+#include "psf.h"
 
 // macOS Big Sur/Monterey Color Palette
 #define COLOR_WHITE 0xFFFFFFFF
 #define COLOR_BLACK 0xFF000000
 #define COLOR_TOPBAR 0xFFF5F5F7 // Light gray with subtle warmth
 #define COLOR_TOPBAR_TEXT 0xFF1D1D1F // Near black for contrast
-#define COLOR_DOCK_BG 0xE6FFFFFF // Semi-transparent white (90% opacity simulation)
+#define COLOR_DOCK_BG 0xE6FFFFFF // Semi-transparent white (90% opacity)
 #define COLOR_DOCK_BORDER 0xFFE5E5E5
 #define COLOR_APPLE_BLUE 0xFF007AFF // macOS accent blue
 #define COLOR_FINDER 0xFF3B99FC // Finder blue
@@ -23,16 +25,84 @@
 #define COLOR_SHADOW_DIRECT 0x60000000 // Stronger direct shadow
 #define COLOR_TEXT_PRIMARY 0xFF1D1D1F
 #define COLOR_TEXT_SECONDARY 0xFF8E8E93
+#define COLOR_TRANSPARENT 0x00000000 // Text background that leaves pixels untouched
+
+// Layout lengths are written for an 800x600 screen and scaled with ui_px()
+#define UI_MAX_SCALE 4
+
+#define TOPBAR_HEIGHT 28 // before scaling
+
+#define CURSOR_WIDTH 10 // before scaling
+#define CURSOR_HEIGHT 16
+
+// Damage is tracked as a short list of rectangles; beyond this they get merged
+#define MAX_DIRTY_RECTS 32
+
+typedef struct {
+    int x, y;
+    int width, height;
+} rect_t;
+
+// Off-screen 32-bit xRGB pixel storage (pitch is in pixels, not bytes)
+typedef struct {
+    uint32_t* pixels;
+    int width, height;
+    int pitch;
+} surface_t;
+
+// Cost of the most recent graphics_present(), for keeping frames bounded
+typedef struct {
+    uint32_t frames;
+    uint32_t pixels;       // damage copied to the framebuffer
+    uint64_t cycles;
+    uint64_t peak_cycles;
+} present_stats_t;
 
 void init_graphics(struct limine_framebuffer *fb);
 void put_pixel(int x, int y, uint32_t color);
 void draw_rect(int x, int y, int width, int height, uint32_t color);
+void draw_rect_blend(int x, int y, int width, int height, uint32_t color);
+void blit_rect(int x, int y, surface_t* src, int sx, int sy, int width, int height);
+void blit_rect_blend(int x, int y, surface_t* src, int sx, int sy, int width, int height);
+void copy_rect(int sx, int sy, int dx, int dy, int width, int height);
 void draw_char(int x, int y, char c, uint32_t color);
 void draw_string(int x, int y, char* str, uint32_t color);
-void draw_cursor(int x, int y);
+void draw_text_run(int x, int y, const char* str, int len, uint32_t fg, uint32_t bg);
 void draw_desktop_background();
+void draw_desktop_region(int x, int y, int width, int height);
 void draw_top_bar(char* time_str);
 void draw_dock();
 void draw_window(int x, int y, int width, int height, char* title);
+void draw_window_shadow(int x, int y, int width, int height);
+
+// Compositor: drawing lands in a RAM back buffer, present copies the damage out
+void graphics_mark_dirty(int x, int y, int width, int height);
+void graphics_invalidate();
+void graphics_present();
+void graphics_set_cursor(int x, int y);
+
+// Restrict drawing to a rectangle, e.g. one piece of a window's visible region
+void graphics_set_clip(int x, int y, int width, int height);
+void graphics_reset_clip();
+
+// Draw into an off-screen surface instead of the screen (NULL switches back).
+// Resets the clip rect to the new target; off-screen drawing is not damage.
+void graphics_set_target(surface_t* surface);
+bool graphics_has_back_buffer();
+const present_stats_t* graphics_present_stats();
+
+// 1 on screens up to 1080p, 2 at 1440p, 3 at 4K; text is pre-scaled to match
+int graphics_ui_scale();
+int ui_px(int px);
+
+// Text uses one bitmap font, pre-scaled by an integer factor
+bool graphics_set_font(const font_t* font, int scale);
+int graphics_char_width();
+int graphics_char_height();
+
+int graphics_width();
+int graphics_height();
+const char* graphics_format_name();
+uint32_t graphics_measure_fill_mbps();
 
 #endif
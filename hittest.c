@@ -0,0 +1,158 @@
+#include "hittest.h"
+#include "memory.h"
+#include "pool.h"
+
+// One list per grid cell of the regions that overlap it
+typedef struct hit_entry {
+    hit_region_t* region;
+    struct hit_entry* next;
+} hit_entry_t;
+
+static hit_entry_t** cells = NULL;
+static int cols = 0, rows = 0;
+static int cell_size = HIT_CELL_SIZE;
+
+static hit_entry_t* linear_cell = NULL; // the only cell without a grid
+
+static pool_t region_pool;
+static pool_t entry_pool;
+
+bool hittest_init(int width, int height) {
+    cell_size = HIT_CELL_SIZE;
+    cols = (width + cell_size - 1) / cell_size;
+    rows = (height + cell_size - 1) / cell_size;
+    cells = (hit_entry_t**)malloc((size_t)cols * rows * sizeof(hit_entry_t*));
+    if (!cells) {
+        cols = rows = 0;
+        return false;
+    }
+    for (int i = 0; i < cols * rows; i++) cells[i] = NULL;
+
+    pool_init(&region_pool, sizeof(hit_region_t), 32);
+    pool_init(&entry_pool, sizeof(hit_entry_t), 256);
+    return true;
+}
+
+void hittest_init_linear(int width, int height) {
+    cell_size = width > height ? width : height;
+    if (cell_size < 1) cell_size = 1;
+    cols = rows = 1;
+    linear_cell = NULL;
+    cells = &linear_cell;
+
+    pool_init(&region_pool, sizeof(hit_region_t), 32);
+    pool_init(&entry_pool, sizeof(hit_entry_t), 32);
+}
+
+static int clamp(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Work out which grid cells the region's rectangle touches. A region entirely
+// off the grid gets an empty range and is filed nowhere.
+static void hittest_cell_range(hit_region_t* region) {
+    region->col0 = clamp(region->x / cell_size, 0, cols - 1);
+    region->row0 = clamp(region->y / cell_size, 0, rows - 1);
+    region->col1 = clamp((region->x + region->width - 1) / cell_size, 0, cols - 1);
+    region->row1 = clamp((region->y + region->height - 1) / cell_size, 0, rows - 1);
+    if (region->width <= 0 || region->height <= 0 ||
+        region->x + region->width <= 0 || region->y + region->height <= 0 ||
+        region->x >= cols * cell_size || region->y >= rows * cell_size) {
+        region->col1 = region->col0 - 1;
+    }
+}
+
+// File the region under every cell in its range
+static void hittest_insert(hit_region_t* region) {
+    for (int row = region->row0; row <= region->row1; row++) {
+        for (int col = region->col0; col <= region->col1; col++) {
+            hit_entry_t* entry = (hit_entry_t*)pool_alloc(&entry_pool);
+            if (!entry) continue; // Out of memory: unclickable in this cell
+            entry->region = region;
+            entry->next = cells[row * cols + col];
+            cells[row * cols + col] = entry;
+        }
+    }
+}
+
+static void hittest_unlink(hit_region_t* region) {
+    for (int row = region->row0; row <= region->row1; row++) {
+        for (int col = region->col0; col <= region->col1; col++) {
+            hit_entry_t** link = &cells[row * cols + col];
+            while (*link && (*link)->region != region) link = &(*link)->next;
+            if (*link) {
+                hit_entry_t* entry = *link;
+                *link = entry->next;
+                pool_free(&entry_pool, entry);
+            }
+        }
+    }
+}
+
+hit_region_t* hittest_add(int x, int y, int width, int height, hit_kind_t kind, void* owner, int index, int layer) {
+    if (!cells) return NULL;
+    hit_region_t* region = (hit_region_t*)pool_alloc(&region_pool);
+    if (!region) return NULL;
+    region->x = x;
+    region->y = y;
+    region->width = width;
+    region->height = height;
+    region->kind = kind;
+    region->owner = owner;
+    region->index = index;
+    region->layer = layer;
+    hittest_cell_range(region);
+    hittest_insert(region);
+    return region;
+}
+
+// A region that stays within the same cells is just updated in place; otherwise
+// it is refiled under its new cells
+void hittest_move(hit_region_t* region, int x, int y, int width, int height) {
+    if (!region) return;
+    hit_region_t moved = *region;
+    moved.x = x;
+    moved.y = y;
+    moved.width = width;
+    moved.height = height;
+    hittest_cell_range(&moved);
+    if (moved.col0 == region->col0 && moved.row0 == region->row0 &&
+        moved.col1 == region->col1 && moved.row1 == region->row1) {
+        *region = moved;
+        return;
+    }
+
+    hittest_unlink(region);
+    *region = moved;
+    hittest_insert(region);
+}
+
+void hittest_set_layer(hit_region_t* region, int layer) {
+    if (region) region->layer = layer;
+}
+
+void hittest_remove(hit_region_t* region) {
+    if (!region) return;
+    hittest_unlink(region);
+    pool_free(&region_pool, region);
+}
+
+hit_t hittest_at(int x, int y) {
+    hit_t hit = { HIT_NONE, NULL, -1 };
+    if (!cells || x < 0 || y < 0) return hit;
+    int col = x / cell_size, row = y / cell_size;
+    if (col >= cols || row >= rows) return hit;
+
+    hit_region_t* best = NULL;
+    for (hit_entry_t* entry = cells[row * cols + col]; entry; entry = entry->next) {
+        hit_region_t* r = entry->region;
+        if (x < r->x || x >= r->x + r->width || y < r->y || y >= r->y + r->height) continue;
+        if (!best || r->layer > best->layer) best = r;
+    }
+    if (best) {
+        hit.kind = best->kind;
+        hit.owner = best->owner;
+        hit.index = best->index;
+    }
+    return hit;
+}
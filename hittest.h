@@ -0,0 +1,48 @@
+#ifndef HITTEST_H
+#define HITTEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Shared point-query service for everything clickable. Regions are bucketed
+// into a uniform grid, so a query only looks at the few regions overlapping
+// one cell. Where regions overlap, the one with the highest layer wins.
+#define HIT_CELL_SIZE 64
+
+typedef enum {
+    HIT_NONE,
+    HIT_DOCK_ICON,
+    HIT_WINDOW,          // window body
+    HIT_TITLE_BAR,
+    HIT_RESIZE_RIGHT,
+    HIT_RESIZE_BOTTOM,
+    HIT_RESIZE_CORNER,
+    HIT_CLOSE
+} hit_kind_t;
+
+typedef struct hit_region {
+    int x, y, width, height;
+    int col0, row0, col1, row1; // grid cells the region is filed under
+    hit_kind_t kind;
+    void* owner;                // window_t* for window parts
+    int index;                  // dock icon index
+    int layer;
+} hit_region_t;
+
+typedef struct {
+    hit_kind_t kind;
+    void* owner;
+    int index;
+} hit_t;
+
+// Returns false if the grid cannot be allocated; hittest_init_linear() then
+// sets up a single cell covering the screen, so every query scans every region
+bool hittest_init(int width, int height);
+void hittest_init_linear(int width, int height);
+hit_region_t* hittest_add(int x, int y, int width, int height, hit_kind_t kind, void* owner, int index, int layer);
+void hittest_move(hit_region_t* region, int x, int y, int width, int height);
+void hittest_set_layer(hit_region_t* region, int layer);
+void hittest_remove(hit_region_t* region);
+hit_t hittest_at(int x, int y);
+
+#endif
@@ -0,0 +1,69 @@
+#include "idt.h"
+
+#define IDT_ENTRIES 256
+#define IDT_INTERRUPT_GATE 0x8E // present, ring 0, 64-bit interrupt gate
+#define IDT_EXCEPTIONS 32
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t ist;
+    uint8_t type_attr;
+    uint16_t offset_mid;
+    uint32_t offset_high;
+    uint32_t reserved;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) idt_pointer_t;
+
+static idt_entry_t idt[IDT_ENTRIES] __attribute__((aligned(16)));
+static uint16_t code_selector;
+
+// A fault we do not handle: stop here rather than triple-fault and reboot
+__attribute__((interrupt))
+static void exception_halt(interrupt_frame_t* frame) {
+    (void)frame;
+    for (;;) asm volatile ("cli; hlt");
+}
+
+__attribute__((interrupt))
+static void exception_halt_error(interrupt_frame_t* frame, uint64_t error) {
+    (void)frame; (void)error;
+    for (;;) asm volatile ("cli; hlt");
+}
+
+// Exceptions for which the CPU pushes an error code
+static int has_error_code(int vector) {
+    return vector == 8 || (vector >= 10 && vector <= 14) || vector == 17 ||
+           vector == 21 || vector == 29 || vector == 30;
+}
+
+void idt_set_handler(uint8_t vector, void* handler) {
+    uint64_t addr = (uint64_t)handler;
+    idt_entry_t* e = &idt[vector];
+    e->offset_low = addr & 0xFFFF;
+    e->selector = code_selector;
+    e->ist = 0;
+    e->type_attr = IDT_INTERRUPT_GATE;
+    e->offset_mid = (addr >> 16) & 0xFFFF;
+    e->offset_high = addr >> 32;
+    e->reserved = 0;
+}
+
+void idt_init() {
+    // Keep whatever code segment the bootloader's GDT put us in
+    asm volatile ("mov %%cs, %0" : "=r"(code_selector));
+
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        idt[i] = (idt_entry_t){0};
+    }
+    for (int i = 0; i < IDT_EXCEPTIONS; i++) {
+        idt_set_handler(i, has_error_code(i) ? (void*)exception_halt_error : (void*)exception_halt);
+    }
+
+    idt_pointer_t ptr = { sizeof(idt) - 1, (uint64_t)idt };
+    asm volatile ("lidt %0" : : "m"(ptr));
+}
@@ -0,0 +1,21 @@
+#ifndef IDT_H
+#define IDT_H
+
+#include <stdint.h>
+
+// What the CPU pushes on entry, as seen by __attribute__((interrupt)) handlers
+typedef struct {
+    uint64_t rip;
+    uint64_t cs;
+    uint64_t rflags;
+    uint64_t rsp;
+    uint64_t ss;
+} interrupt_frame_t;
+
+// Load an IDT whose CPU exception vectors halt; everything else is not present
+void idt_init();
+
+// Install an __attribute__((interrupt)) handler as an interrupt gate
+void idt_set_handler(uint8_t vector, void* handler);
+
+#endif
@@ -0,0 +1,138 @@
+#include <stddef.h>
+#include "input.h"
+#include "keyboard.h"
+#include "mouse.h"
+
+static input_event_t queue[INPUT_QUEUE_SIZE];
+static int head = 0;   // next event to hand out
+static int count = 0;
+static uint32_t dropped = 0;
+
+static bool extended_key = false; // last keyboard byte was the 0xE0 prefix
+
+void input_init() {
+    head = 0;
+    count = 0;
+    dropped = 0;
+    extended_key = false;
+}
+
+static void input_push(const input_event_t* event) {
+    if (count == INPUT_QUEUE_SIZE) {
+        dropped++;
+        return;
+    }
+    queue[(head + count) % INPUT_QUEUE_SIZE] = *event;
+    count++;
+}
+
+// The newest queued event if it is of `type`. Queued events have not been
+// handed out yet, so motion or wheel steps can still be folded into it;
+// anything queued after it (a click, a key) ends that.
+static input_event_t* input_tail(input_type_t type) {
+    if (count == 0) return NULL;
+    input_event_t* last = &queue[(head + count - 1) % INPUT_QUEUE_SIZE];
+    return last->type == type ? last : NULL;
+}
+
+// Start an event stamped with the pointer state it leaves behind
+static input_event_t input_event(input_type_t type, uint64_t now) {
+    mouse_state_t* mouse = mouse_get_state();
+    input_event_t event = { 0 };
+    event.type = type;
+    event.timestamp = now;
+    event.x = mouse->x;
+    event.y = mouse->y;
+    event.buttons = mouse->buttons;
+    return event;
+}
+
+static void input_key_byte(uint8_t data, uint64_t now) {
+    if (data == 0xE0) {
+        extended_key = true;
+        return;
+    }
+    input_event_t event = input_event((data & 0x80) ? INPUT_KEY_UP : INPUT_KEY_DOWN, now);
+    event.scancode = (extended_key ? 0xE000 : 0) | (data & 0x7F);
+    event.key = extended_key ? 0 : keyboard_scancode_to_char(data);
+    extended_key = false;
+    input_push(&event);
+}
+
+static void input_mouse_packet(const mouse_packet_t* packet) {
+    uint64_t now = packet->timestamp;
+    uint8_t old_buttons = mouse_get_state()->buttons;
+    int dx, dy, wheel;
+    mouse_apply_packet(packet, &dx, &dy, &wheel);
+
+    // Movement first, so a press lands where the pointer ended up
+    if (dx || dy) {
+        input_event_t event = input_event(INPUT_MOTION, now);
+        event.dx = dx;
+        event.dy = dy;
+        input_event_t* last = input_tail(INPUT_MOTION);
+        if (last) {
+            // Consumer is behind: fold into the queued motion, keeping its deltas
+            event.dx += last->dx;
+            event.dy += last->dy;
+            *last = event;
+        } else {
+            input_push(&event);
+        }
+    }
+
+    if (wheel) {
+        input_event_t event = input_event(INPUT_WHEEL, now);
+        event.wheel = wheel;
+        input_event_t* last = input_tail(INPUT_WHEEL);
+        if (last) {
+            event.wheel += last->wheel;
+            *last = event;
+        } else {
+            input_push(&event);
+        }
+    }
+
+    uint8_t changed = old_buttons ^ mouse_get_state()->buttons;
+    for (uint8_t bit = INPUT_BUTTON_LEFT; bit <= INPUT_BUTTON_MIDDLE; bit <<= 1) {
+        if (!(changed & bit)) continue;
+        input_event_t event = input_event((mouse_get_state()->buttons & bit) ? INPUT_BUTTON_DOWN : INPUT_BUTTON_UP, now);
+        event.button = bit;
+        input_push(&event);
+    }
+}
+
+// Move everything the IRQ handlers have received into the queue. The keyboard
+// and mouse rings are merged by arrival time, so a click typed between two
+// keys stays between them.
+void input_poll() {
+    keyboard_byte_t key;
+    mouse_packet_t packet;
+    bool have_key = keyboard_next(&key);
+    bool have_packet = mouse_next_packet(&packet);
+    while (have_key || have_packet) {
+        if (have_key && (!have_packet || key.timestamp <= packet.timestamp)) {
+            input_key_byte(key.scancode, key.timestamp);
+            have_key = keyboard_next(&key);
+        } else {
+            input_mouse_packet(&packet);
+            have_packet = mouse_next_packet(&packet);
+        }
+    }
+}
+
+bool input_pending() {
+    return count > 0 || keyboard_pending() || mouse_pending();
+}
+
+bool input_next(input_event_t* event) {
+    if (count == 0) return false;
+    *event = queue[head];
+    head = (head + 1) % INPUT_QUEUE_SIZE;
+    count--;
+    return true;
+}
+
+uint32_t input_dropped() {
+    return dropped + keyboard_dropped() + mouse_dropped();
+}
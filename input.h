@@ -0,0 +1,52 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Keyboard and mouse input as one ordered queue of timestamped events.
+// The PS/2 interrupt handlers buffer raw bytes as they arrive; input_poll()
+// decodes them into events and the desktop drains the queue once per frame
+// with input_next().
+#define INPUT_QUEUE_SIZE 256
+
+typedef enum {
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+    INPUT_MOTION,
+    INPUT_BUTTON_DOWN,
+    INPUT_BUTTON_UP,
+    INPUT_WHEEL
+} input_type_t;
+
+// Lines a text view scrolls per wheel step
+#define INPUT_WHEEL_LINES 3
+
+// Button bits, as in mouse_state_t
+#define INPUT_BUTTON_LEFT 0x01
+#define INPUT_BUTTON_RIGHT 0x02
+#define INPUT_BUTTON_MIDDLE 0x04
+
+typedef struct {
+    input_type_t type;
+    uint64_t timestamp;  // TSC when the interrupt took the event's last byte
+    int x, y;            // pointer position after the event
+    uint8_t buttons;     // buttons held after the event
+    uint8_t button;      // INPUT_BUTTON_* for button events
+    uint16_t scancode;   // Set 1 make code for key events, 0xE0xx if extended
+    char key;            // character for key events, 0 if the key has none
+    int dx, dy;          // motion (summed over coalesced events)
+    int wheel;           // wheel steps, positive away from the user
+} input_event_t;
+
+void input_init();
+void input_poll();
+bool input_next(input_event_t* event);
+
+// Anything received or queued that input_next() has not returned yet
+bool input_pending();
+
+// Events and bytes lost because the queue or a driver ring was full
+uint32_t input_dropped();
+
+#endif
@@ -19,6 +19,28 @@ static volatile struct limine_framebuffer_request framebuffer_request = {
     .revision = 0
 };
 
+// Needed to reach page tables and physical memory (HHDM)
+__attribute__((used, section(".requests")))
+static volatile struct limine_hhdm_request hhdm_request = {
+    .id = LIMINE_HHDM_REQUEST,
+    .revision = 0
+};
+
+// All usable RAM goes to the physical memory manager
+__attribute__((used, section(".requests")))
+static volatile struct limine_memmap_request memmap_request = {
+    .id = LIMINE_MEMMAP_REQUEST,
+    .revision = 0
+};
+
+// A PSF1/PSF2 console font may be supplied as a module; the first one that
+// parses replaces the built-in 8x8 font
+__attribute__((used, section(".requests")))
+static volatile struct limine_module_request module_request = {
+    .id = LIMINE_MODULE_REQUEST,
+    .revision = 0
+};
+
 // Halts the CPU
 static void hcf(void) {
     asm("cli");
@@ -30,22 +52,42 @@ static void hcf(void) {
 // The following will be our kernel's entry point.
 // If renaming _start() to something else, make sure to change the
 // linker script accordingly.
+#include "cpu.h"
+#include "string.h"
 #include "graphics.h"
 #include "keyboard.h"
 #include "shell.h"
 #include "memory.h"
+#include "pmm.h"
+#include "vmm.h"
 #include "mouse.h"
+#include "input.h"
 #include "rtc.h"
 #include "window.h"
 #include "dock.h"
 #include "auth.h"
 #include "login.h"
 #include "nano.h"
+#include "timer.h"
+#include "pat.h"
+#include "idt.h"
+#include "pic.h"
+#include "frame.h"
+#include "profile.h"
+#include "serial.h"
+#include "trace.h"
+#include "hittest.h"
 
 // ... (Keep headers and Limine requests) ...
 
 // Use the exact same Limine requests as before
 
+// Replaces the bootloader's stack once the VMM is up
+#define KERNEL_STACK_SIZE (64 * 1024)
+
+__attribute__((noreturn))
+static void kernel_main(void);
+
 // The following will be our kernel's entry point.
 void _start(void) {
     // Ensure we got a framebuffer.
@@ -54,52 +96,119 @@ void _start(void) {
         hcf();
     }
 
+    // Detect CPU features and enable SSE for the blit kernels; memcpy and
+    // friends pick their copy strategy from the same features
+    cpu_init();
+    string_init();
+    
+    // COM1 carries the binary trace stream when a UART is present
+    serial_init();
+    
+    // Physical pages from the memory map, reached through the HHDM; the VMM
+    // builds its page tables from them and the heap grows from them
+    if (memmap_request.response == NULL || hhdm_request.response == NULL
+     || !pmm_init(memmap_request.response, hhdm_request.response->offset)
+     || !vmm_init(hhdm_request.response->offset)) {
+        hcf();
+    }
+    
+    // Move to a stack with unmapped guard pages on both sides, so running off
+    // either end faults instead of overwriting whatever lies next to it
+    void* stack = vmm_alloc_stack(KERNEL_STACK_SIZE);
+    if (stack) {
+        // Operands pinned away from %rbp, which the asm clears
+        asm volatile ("mov %0, %%rsp; xor %%ebp, %%ebp; call *%1"
+                      : : "D"(stack), "a"(kernel_main) : "memory");
+    }
+    kernel_main();
+}
+
+static void kernel_main(void) {
     // Fetch the first framebuffer.
     struct limine_framebuffer *framebuffer = framebuffer_request.response->framebuffers[0];
-
+    
+    memory_init();
+    
     // Initialize Graphics Support
     init_graphics(framebuffer);
     
-    // Initialize Memory Manager
-    memory_init();
+    // Calibrate the TSC, then remap the framebuffer write-combining and record
+    // how much that changed fill bandwidth
+    timer_init();
+    pat_status.fill_mbps_before = graphics_measure_fill_mbps();
+    if (pat_init()) {
+        // Retype the HHDM alias too, so no two mappings of the framebuffer
+        // disagree on its memory type, then draw through a mapping of our own
+        // made of 2 MiB pages
+        size_t fb_size = framebuffer->pitch * framebuffer->height;
+        if (pat_map_write_combining(framebuffer->address, fb_size)) {
+            void* mapping = vmm_map_phys(pmm_to_phys(framebuffer->address), fb_size, VMM_DATA | VMM_WC);
+            if (mapping) framebuffer->address = mapping;
+        }
+    }
+    pat_status.fill_mbps_after = graphics_measure_fill_mbps();
+    
+    // Pick up a console font module; text is pre-scaled to the UI scale
+    static font_t module_font;
+    const font_t* font = font_builtin();
+    if (module_request.response) {
+        for (uint64_t i = 0; i < module_request.response->module_count; i++) {
+            struct limine_file* module = module_request.response->modules[i];
+            if (psf_load(module->address, module->size, &module_font)) {
+                font = &module_font;
+                break;
+            }
+        }
+    }
+    graphics_set_font(font, graphics_ui_scale());
+    
+    // Interrupts: CPU exceptions, the PICs, and a 1 kHz PIT tick that paces frames
+    idt_init();
+    pic_init();
+    timer_start_ticks();
+    timer_set_tick_handler(serial_drain);
+    asm volatile ("sti");
+    trace_init();
+    frame_init(FRAME_RATE_DEFAULT);
+    profile_init();
     
     // Initialize Authentication System
     auth_init();
     login_init();
     
-    // Initialize Mouse (needed for login screen)
+    // PS/2 mouse and keyboard, interrupt driven (needed for login screen)
+    mouse_set_bounds(graphics_width(), graphics_height());
     mouse_init();
+    keyboard_init();
+    input_init();
     
     // Draw login screen background
     draw_desktop_background();
     
     // Login loop
-    uint8_t prev_login_buttons = 0;
     while (!login_is_complete()) {
+        // Sleep until the next frame or until input arrives
+        frame_wait();
+        
         login_render();
         
-        // Poll keyboard for login input
-        char c = keyboard_read_char();
-        if (c != 0) {
-            login_handle_key(c);
+        // Keys and clicks since the last frame, in the order they happened
+        input_poll();
+        input_event_t ev;
+        while (input_next(&ev)) {
+            if (ev.type == INPUT_KEY_DOWN && ev.key != 0) {
+                login_handle_key(ev.key);
+            } else if (ev.type == INPUT_BUTTON_DOWN && ev.button == INPUT_BUTTON_LEFT) {
+                login_handle_click(ev.x, ev.y);
+            }
         }
-        
-        // Poll mouse for login clicks
-        mouse_handle_interrupt();
         mouse_state_t* mouse = mouse_get_state();
         
-        uint8_t buttons = mouse->buttons;
-        if ((buttons & 1) && !(prev_login_buttons & 1)) {
-            // Left button pressed
-            login_handle_click(mouse->x, mouse->y);
-        }
-        prev_login_buttons = buttons;
-        
-        // Draw cursor
-        draw_cursor(mouse->x, mouse->y);
+        // Move the cursor sprite
+        graphics_set_cursor(mouse->x, mouse->y);
         
-        // Small delay
-        for(volatile int i=0; i<10000; i++);
+        // Copy this frame's damage to the screen
+        graphics_present();
     }
     
     // Login successful - continue to desktop
@@ -107,6 +216,12 @@ void _start(void) {
     // Mouse already initialized above
     // mouse_init(); // Remove duplicate
     
+    // Window manager and dock file their clickable areas with the hit-test grid;
+    // without memory for it, queries scan every region instead
+    if (!hittest_init(graphics_width(), graphics_height())) {
+        hittest_init_linear(graphics_width(), graphics_height());
+    }
+    
     // Initialize Window Manager
     wm_init();
     dock_init();
@@ -126,66 +241,104 @@ void _start(void) {
     dock_render();
     
     // Auto-launch Terminal window after login
-    window_t* terminal_win = wm_create_window(150, 120, 500, 350, "Terminal", WINDOW_TERMINAL);
+    window_t* terminal_win = wm_create_window(ui_px(150), ui_px(120), ui_px(500), ui_px(350), "Terminal", WINDOW_TERMINAL);
     if (terminal_win) {
-        dock_set_app_running(2, true); // Terminal is icon index 2
+        terminal_win->dock_icon = 2; // Terminal is icon index 2
+        dock_set_app_running(2, true);
     }
     
     // Initial dock render
     dock_render();
     
-    int frame_counter = 0;
-    uint8_t prev_buttons = 0;
+    uint64_t clock_updated_ms = timer_ms();
+    uint32_t frame_number = 0;
     bool desktop_needs_redraw = false;
 
     while (1) {
+        // Sleep until the next frame or until input arrives
+        frame_wait();
+        trace_frame_begin(frame_number);
+        profile_begin(PROF_FRAME);
+        profile_begin(PROF_INPUT);
+        
         // Check if nano was requested from shell
         if (nano_requested) {
             nano_open(nano_requested_file[0] != '\0' ? nano_requested_file : NULL);
-            wm_create_window(100, 80, 600, 400, "Nano Editor", WINDOW_NANO);
+            if (!wm_create_window(ui_px(100), ui_px(80), ui_px(600), ui_px(400), "Nano Editor", WINDOW_NANO)) {
+                nano_close(); // No window to edit in
+            }
             nano_requested = false;
             desktop_needs_redraw = true;
         }
         
-        // Poll Keyboard
-        char c = keyboard_read_char();
-        if (c != 0) {
-            // Route keyboard input to nano if active, otherwise to shell
-            if (nano_is_active()) {
-                nano_handle_key(c);
-            } else {
-                shell_handle_key(c);
+        // Handle everything that arrived since the last frame in one batch.
+        // Pointer motion is coalesced in the queue, so a busy mouse costs one
+        // motion event per frame rather than one per packet.
+        input_poll();
+        input_event_t ev;
+        while (input_next(&ev)) {
+            switch (ev.type) {
+                case INPUT_KEY_DOWN:
+                    if (ev.key == 0) break;
+                    trace_key(ev.key);
+                    // Route keyboard input to nano if active, otherwise to shell
+                    if (nano_is_active()) {
+                        nano_handle_key(ev.key);
+                        if (!nano_is_active()) {
+                            // ^X: the editor window goes away with the editor
+                            wm_destroy_window(wm_find_window(WINDOW_NANO));
+                        }
+                    } else {
+                        shell_handle_key(ev.key);
+                    }
+                    break;
+                case INPUT_MOTION:
+                    trace_mouse(ev.x, ev.y, ev.buttons);
+                    // Button held - handle dragging
+                    if (ev.buttons & INPUT_BUTTON_LEFT) {
+                        wm_handle_mouse_move(ev.x, ev.y);
+                    }
+                    break;
+                case INPUT_BUTTON_DOWN:
+                    trace_mouse(ev.x, ev.y, ev.buttons);
+                    // Left button pressed: windows are above the dock
+                    if (ev.button == INPUT_BUTTON_LEFT && !wm_handle_mouse_down(ev.x, ev.y)) {
+                        dock_handle_click(ev.x, ev.y);
+                    }
+                    break;
+                case INPUT_BUTTON_UP:
+                    trace_mouse(ev.x, ev.y, ev.buttons);
+                    if (ev.button == INPUT_BUTTON_LEFT) {
+                        wm_handle_mouse_up(ev.x, ev.y);
+                    }
+                    break;
+                case INPUT_WHEEL: {
+                    // Scroll the text in the focused window, like keys
+                    window_t* focused = wm_get_active_window();
+                    if (focused && focused->type == WINDOW_NANO && nano_is_active()) {
+                        nano_scroll(ev.wheel * INPUT_WHEEL_LINES);
+                    } else if (focused && focused->type == WINDOW_TERMINAL) {
+                        shell_scroll(ev.wheel * INPUT_WHEEL_LINES);
+                    }
+                    break;
+                }
+                default:
+                    break;
             }
         }
-        
-        // Poll Mouse
-        mouse_handle_interrupt();
         mouse_state_t* mouse = mouse_get_state();
         
-        // Handle mouse button events
-        uint8_t buttons = mouse->buttons;
-        if ((buttons & 1) && !(prev_buttons & 1)) {
-            // Left button pressed
-            wm_handle_mouse_down(mouse->x, mouse->y);
-            dock_handle_click(mouse->x, mouse->y);
-        } else if (!(buttons & 1) && (prev_buttons & 1)) {
-            // Left button released
-            wm_handle_mouse_up(mouse->x, mouse->y);
-        }
-        
-        if (buttons & 1) {
-            // Button held - handle dragging
-            wm_handle_mouse_move(mouse->x, mouse->y);
-        }
-        
-        prev_buttons = buttons;
+        profile_end(PROF_INPUT);
         
         // Update dock magnification based on mouse position
+        profile_begin(PROF_DOCK);
         dock_update_magnification(mouse->x, mouse->y);
+        profile_end(PROF_DOCK);
         
-        // Update clock every ~1000 frames
-        if (frame_counter++ > 1000) {
-            frame_counter = 0;
+        // Update clock once a second
+        profile_begin(PROF_BACKGROUND);
+        if (timer_ms() - clock_updated_ms >= 1000) {
+            clock_updated_ms = timer_ms();
             rtc_read_time(&current_time);
             rtc_format_time(&current_time, time_buffer);
             draw_top_bar(time_buffer);
@@ -198,28 +351,60 @@ void _start(void) {
             desktop_needs_redraw = false;
         }
         
+        // Repair wallpaper where windows moved away and under their shadows;
+        // the top bar may have been covered too
+        if (wm_restore_background()) {
+            draw_top_bar(time_buffer);
+        }
+        profile_end(PROF_BACKGROUND);
+        
         // Redraw dock every frame for smooth magnification
+        profile_begin(PROF_DOCK);
         dock_render();
+        profile_end(PROF_DOCK);
         
-        // Render all windows
-        wm_render_all();
-        
-        // Render shell or nano in active window
+        // Shell or nano redraw the active window's surface when their content
+        // changed, or when the window manager rebuilt it (new or resized window)
         window_t* active_win = wm_get_active_window();
-        if (active_win) {
-            if (active_win->type == WINDOW_TERMINAL) {
-                // Always render shell to prevent flickering
-                shell_update(active_win->x, active_win->y, active_win->width, active_win->height);
-            } else if (active_win->type == WINDOW_NANO && nano_needs_redraw()) {
-                nano_render(active_win->x, active_win->y, active_win->width, active_win->height);
+        if (active_win && active_win->type == WINDOW_TERMINAL) {
+            if (active_win->frame_dirty || active_win->content_dirty) shell_set_dirty();
+            if (shell_needs_redraw()) {
+                profile_begin(PROF_SHELL);
+                wm_begin_paint(active_win);
+                shell_update(0, 0, active_win->width, active_win->height);
+                wm_end_paint(active_win);
+                profile_end(PROF_SHELL);
+            }
+        } else if (active_win && active_win->type == WINDOW_NANO) {
+            if (active_win->frame_dirty || active_win->content_dirty) nano_set_dirty();
+            if (nano_needs_redraw()) {
+                profile_begin(PROF_NANO);
+                wm_begin_paint(active_win);
+                nano_render(0, 0, active_win->width, active_win->height);
+                wm_end_paint(active_win);
+                profile_end(PROF_NANO);
             }
         }
         
-        // Draw Cursor on top
-        draw_cursor(mouse->x, mouse->y);
+        // Composite the window surfaces
+        profile_begin(PROF_WINDOWS);
+        wm_render_all();
+        profile_end(PROF_WINDOWS);
+        
+        // Frame statistics overlay, when enabled from the shell
+        profile_hud_render();
+        
+        // Cursor is layered on top at present time
+        graphics_set_cursor(mouse->x, mouse->y);
+        
+        // Copy this frame's damage to the screen
+        profile_begin(PROF_PRESENT);
+        graphics_present();
+        profile_end(PROF_PRESENT);
         
-        // Small delay
-        for(volatile int i=0; i<10000; i++); 
+        profile_end(PROF_FRAME);
+        profile_frame_end();
+        trace_frame_end(frame_number++);
     }
 }
 
@@ -1,5 +1,8 @@
+#include "keyboard.h"
 #include "io.h"
-#include <stdint.h>
+#include "idt.h"
+#include "pic.h"
+#include "timer.h"
 
 // Scancode Set 1 (US QWERTY)
 static char scancode_map[128] = {
@@ -12,32 +15,69 @@ static char scancode_map[128] = {
     0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
 };
 
-// Check if a key is waiting to be read
-int keyboard_hit() {
-    uint8_t status = inb(0x64);
-    return (status & 1); // Bit 0 set means output buffer full
-}
+// Single producer (the IRQ1 handler), single consumer (the main loop). Each
+// side only writes its own index; the compiler barrier orders the entry
+// against the index update, and x86 keeps stores in order for the other side.
+static keyboard_byte_t ring[KEYBOARD_RING_SIZE];
+static volatile uint32_t ring_head = 0; // next entry to fill, owned by the IRQ
+static volatile uint32_t ring_tail = 0; // next entry to take, owned by the main loop
+static volatile uint32_t dropped = 0;
 
-// Read the next character (blocking or non-blocking logic via polling)
-// Returns 0 if no new key or non-printable scancode
-char keyboard_read_char() {
-    if (!keyboard_hit()) {
-        return 0;
-    }
-    
-    uint8_t scancode = inb(0x60);
+#define barrier() asm volatile ("" ::: "memory")
+
+__attribute__((interrupt))
+static void keyboard_irq(interrupt_frame_t* frame) {
+    (void)frame;
     
-    // Ignore key release (break codes have bit 7 set)
-    if (scancode & 0x80) {
-        return 0; 
+    // The mouse driver may have polled this byte away while reconfiguring
+    if ((inb(0x64) & 0x21) != 0x01) {
+        pic_eoi(IRQ_KEYBOARD);
+        return;
     }
-    
-    // Only accept valid scancodes
-    if (scancode >= 128) {
-        return 0;
+    uint8_t data = inb(0x60);
+    uint32_t head = ring_head;
+    if (head - ring_tail < KEYBOARD_RING_SIZE) {
+        keyboard_byte_t* entry = &ring[head & (KEYBOARD_RING_SIZE - 1)];
+        entry->timestamp = rdtsc();
+        entry->scancode = data;
+        barrier();
+        ring_head = head + 1;
+    } else {
+        dropped++;
     }
-    
-    char c = scancode_map[scancode];
+    pic_eoi(IRQ_KEYBOARD);
+}
+
+void keyboard_init() {
+    // Whatever arrived before the handler existed is stale
+    while (inb(0x64) & 1) inb(0x60);
+
+    idt_set_handler(PIC_IRQ_BASE + IRQ_KEYBOARD, (void*)keyboard_irq);
+    pic_unmask(IRQ_KEYBOARD);
+}
+
+bool keyboard_next(keyboard_byte_t* out) {
+    uint32_t tail = ring_tail;
+    if (tail == ring_head) return false;
+    barrier();
+    *out = ring[tail & (KEYBOARD_RING_SIZE - 1)];
+    barrier();
+    ring_tail = tail + 1;
+    return true;
+}
+
+bool keyboard_pending() {
+    return ring_tail != ring_head;
+}
+
+uint32_t keyboard_dropped() {
+    return dropped;
+}
+
+// Bytes are decoded by input_poll(); this only translates.
+// Break codes (bit 7 set) translate to the same key's character.
+char keyboard_scancode_to_char(uint8_t scancode) {
+    char c = scancode_map[scancode & 0x7F];
     
     // Only return printable characters, backspace, enter, tab
     if (c >= 32 && c < 127) {
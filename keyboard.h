@@ -1,7 +1,29 @@
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
 
-char keyboard_read_char();
-int keyboard_hit();
+#include <stdint.h>
+#include <stdbool.h>
+
+// Scancodes received by the IRQ1 handler wait here; must be a power of two
+#define KEYBOARD_RING_SIZE 128
+
+typedef struct {
+    uint64_t timestamp; // TSC when the interrupt took the byte
+    uint8_t scancode;   // raw Set 1 byte, including 0xE0 prefixes and break codes
+} keyboard_byte_t;
+
+// Install the IRQ1 handler. Call after mouse_init(), which enables the
+// controller's interrupts and must still poll for the mouse's replies.
+void keyboard_init();
+
+// Take the oldest received byte; false if there is none. Main loop only.
+bool keyboard_next(keyboard_byte_t* out);
+bool keyboard_pending();
+
+// Bytes lost because the ring was full
+uint32_t keyboard_dropped();
+
+// Character for a Set 1 make code, or 0 if the key has none we use
+char keyboard_scancode_to_char(uint8_t scancode);
 
 #endif
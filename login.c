@@ -1,11 +1,7 @@
 #include "login.h"
 #include "graphics.h"
 #include "auth.h"
-
-// External string helpers
-extern int strcmp(const char* s1, const char* s2);
-extern void strcpy(char* dest, const char* src);
-extern int strlen(const char* str);
+#include "string.h"
 
 #define MAX_INPUT 64
 
@@ -27,40 +23,51 @@ void login_init() {
     error_message[0] = '\0';
 }
 
+// Draw text horizontally centered on `center_x`
+static void draw_centered(int center_x, int y, char* str, uint32_t color) {
+    draw_string(center_x - strlen(str) * graphics_char_width() / 2, y, str, color);
+}
+
 void login_render() {
-    // Center coordinates
-    int center_x = 400;
-    int center_y = 300;
+    // Center coordinates; the form is laid out at 800x600 and scaled with ui_px()
+    int center_x = graphics_width() / 2;
+    int center_y = graphics_height() / 2;
+    int field_w = ui_px(200);
+    int field_h = ui_px(32);
+    int field_x = center_x - ui_px(100);
+    int text_x = center_x - ui_px(90);
+    int text_dy = (field_h - graphics_char_height()) / 2;
     
     // User avatar circle (simplified as square)
-    draw_rect(center_x - 40, center_y - 120, 80, 80, COLOR_APPLE_BLUE);
+    draw_rect(center_x - ui_px(40), center_y - ui_px(120), ui_px(80), ui_px(80), COLOR_APPLE_BLUE);
     
     // Username label
-    draw_string(center_x - 100, center_y - 20, "Username:", COLOR_TEXT_PRIMARY);
+    draw_string(field_x, center_y - ui_px(20), "Username:", COLOR_TEXT_PRIMARY);
     
     // Username input box
-    draw_rect(center_x - 100, center_y, 200, 32, COLOR_WHITE);
-    draw_rect(center_x - 100, center_y, 200, 1, COLOR_DOCK_BORDER); // Top border
-    draw_rect(center_x - 100, center_y + 31, 200, 1, COLOR_DOCK_BORDER); // Bottom border
+    draw_rect(field_x, center_y, field_w, field_h, COLOR_WHITE);
+    draw_rect(field_x, center_y, field_w, 1, COLOR_DOCK_BORDER); // Top border
+    draw_rect(field_x, center_y + field_h - 1, field_w, 1, COLOR_DOCK_BORDER); // Bottom border
     
     if (!on_password_field) {
         // Active field indicator
-        draw_rect(center_x - 100, center_y + 31, 200, 2, COLOR_APPLE_BLUE);
+        draw_rect(field_x, center_y + field_h - 1, field_w, ui_px(2), COLOR_APPLE_BLUE);
     }
     
-    draw_string(center_x - 90, center_y + 10, username_input, COLOR_TEXT_PRIMARY);
+    draw_string(text_x, center_y + text_dy, username_input, COLOR_TEXT_PRIMARY);
     
     // Password label
-    draw_string(center_x - 100, center_y + 50, "Password:", COLOR_TEXT_PRIMARY);
+    draw_string(field_x, center_y + ui_px(50), "Password:", COLOR_TEXT_PRIMARY);
     
     // Password input box
-    draw_rect(center_x - 100, center_y + 70, 200, 32, COLOR_WHITE);
-    draw_rect(center_x - 100, center_y + 70, 200, 1, COLOR_DOCK_BORDER);
-    draw_rect(center_x - 100, center_y + 101, 200, 1, COLOR_DOCK_BORDER);
+    int password_y = center_y + ui_px(70);
+    draw_rect(field_x, password_y, field_w, field_h, COLOR_WHITE);
+    draw_rect(field_x, password_y, field_w, 1, COLOR_DOCK_BORDER);
+    draw_rect(field_x, password_y + field_h - 1, field_w, 1, COLOR_DOCK_BORDER);
     
     if (on_password_field) {
         // Active field indicator
-        draw_rect(center_x - 100, center_y + 101, 200, 2, COLOR_APPLE_BLUE);
+        draw_rect(field_x, password_y + field_h - 1, field_w, ui_px(2), COLOR_APPLE_BLUE);
     }
     
     // Show password as asterisks
@@ -69,19 +76,21 @@ void login_render() {
         masked[i] = '*';
     }
     masked[password_len] = '\0';
-    draw_string(center_x - 90, center_y + 80, masked, COLOR_TEXT_PRIMARY);
+    draw_string(text_x, password_y + text_dy, masked, COLOR_TEXT_PRIMARY);
     
     // Login button
-    draw_rect(center_x - 50, center_y + 120, 100, 36, COLOR_APPLE_BLUE);
-    draw_string(center_x - 20, center_y + 130, "Login", COLOR_WHITE);
+    int button_y = center_y + ui_px(120);
+    int button_h = ui_px(36);
+    draw_rect(center_x - ui_px(50), button_y, ui_px(100), button_h, COLOR_APPLE_BLUE);
+    draw_centered(center_x, button_y + (button_h - graphics_char_height()) / 2, "Login", COLOR_WHITE);
     
     // Error message
     if (error_message[0] != '\0') {
-        draw_string(center_x - 80, center_y + 170, error_message, 0xFFFF3B30); // Red
+        draw_centered(center_x, center_y + ui_px(170), error_message, 0xFFFF3B30); // Red
     }
     
     // AquaOS branding
-    draw_string(center_x - 40, center_y - 200, "AquaOS", COLOR_TEXT_PRIMARY);
+    draw_centered(center_x, center_y - ui_px(200), "AquaOS", COLOR_TEXT_PRIMARY);
 }
 
 void login_handle_key(char c) {
@@ -127,26 +136,26 @@ void login_handle_key(char c) {
 }
 
 void login_handle_click(int x, int y) {
-    int center_x = 400;
-    int center_y = 300;
+    int center_x = graphics_width() / 2;
+    int center_y = graphics_height() / 2;
     
     // Check if clicking on username field
-    if (x >= center_x - 100 && x < center_x + 100 &&
-        y >= center_y && y < center_y + 32) {
+    if (x >= center_x - ui_px(100) && x < center_x + ui_px(100) &&
+        y >= center_y && y < center_y + ui_px(32)) {
         on_password_field = false;
         return;
     }
     
     // Check if clicking on password field
-    if (x >= center_x - 100 && x < center_x + 100 &&
-        y >= center_y + 70 && y < center_y + 102) {
+    if (x >= center_x - ui_px(100) && x < center_x + ui_px(100) &&
+        y >= center_y + ui_px(70) && y < center_y + ui_px(102)) {
         on_password_field = true;
         return;
     }
     
     // Check if clicking on login button
-    if (x >= center_x - 50 && x < center_x + 50 &&
-        y >= center_y + 120 && y < center_y + 156) {
+    if (x >= center_x - ui_px(50) && x < center_x + ui_px(50) &&
+        y >= center_y + ui_px(120) && y < center_y + ui_px(156)) {
         // Attempt login
         if (auth_verify_login(username_input, password_input)) {
             login_complete = true;
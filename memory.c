@@ -1,74 +1,345 @@
 #include "memory.h"
+#include "slab.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "trace.h"
 
-#define HEAP_SIZE 1024 * 1024 * 32 // 32 MB Heap
+// The heap starts empty and takes regions of at least this many pages (as a
+// buddy order) from the PMM whenever no free block fits
+#define HEAP_GROW_ORDER 10 // 4 MiB
 
-// Static heap to avoid complex paging logic for this demo
-static uint8_t heap_data[HEAP_SIZE];
+// Two-level segregated fit (TLSF). Free blocks are kept in lists by size: the
+// first level splits sizes by power of two, the second splits each power of
+// two into SL_COUNT equal ranges. Two bitmaps say which lists are non-empty,
+// so finding a fitting block, splitting it and merging on free are all O(1).
+//
+// Every block starts with a boundary tag: its payload size plus two flags,
+// and a pointer to the physically previous block, which is only meaningful
+// while that block is free. That lets free() merge in both directions.
+#define ALIGN_LOG2 4
+#define ALIGN (1 << ALIGN_LOG2)
+#define SL_LOG2 4
+#define SL_COUNT (1 << SL_LOG2)
+#define FL_SHIFT (SL_LOG2 + ALIGN_LOG2) // sizes below 1 << FL_SHIFT share first level 0
+#define FL_COUNT 40                     // blocks up to 2^46 bytes
 
-typedef struct block_header {
+#define BLOCK_FREE 1
+#define BLOCK_PREV_FREE 2
+#define BLOCK_FLAGS (BLOCK_FREE | BLOCK_PREV_FREE)
+#define BLOCK_MIN 16 // payload of a free block holds its list links
+
+typedef struct block {
+    struct block* prev_phys;
+    size_t size;                // payload bytes | BLOCK_* flags
+    struct block* next_free;    // payload from here; free blocks only
+    struct block* prev_free;
+} block_t;
+
+#define BLOCK_HEADER offsetof(block_t, next_free)
+
+// Regions taken from the PMM, chained through a header at their start
+typedef struct heap_region {
+    struct heap_region* next;
     size_t size;
-    struct block_header* next;
-    int is_free;
-} block_header_t;
+} heap_region_t;
+
+static uint64_t fl_bitmap = 0;
+static uint32_t sl_bitmap[FL_COUNT];
+static block_t* free_lists[FL_COUNT][SL_COUNT];
+
+static heap_region_t* regions = NULL;
+
+static inline size_t block_size(const block_t* block) {
+    return block->size & ~(size_t)BLOCK_FLAGS;
+}
+
+static inline void* block_payload(block_t* block) {
+    return (uint8_t*)block + BLOCK_HEADER;
+}
+
+static inline block_t* block_of(void* ptr) {
+    return (block_t*)((uint8_t*)ptr - BLOCK_HEADER);
+}
+
+static inline block_t* block_next(block_t* block) {
+    return (block_t*)((uint8_t*)block_payload(block) + block_size(block));
+}
+
+static inline int fls64(size_t v) {
+    return 63 - __builtin_clzll(v);
+}
+
+// List holding blocks of exactly `size` bytes
+static void mapping_insert(size_t size, int* fl, int* sl) {
+    if (size < (1 << FL_SHIFT)) {
+        *fl = 0;
+        *sl = size / ALIGN;
+    } else {
+        int t = fls64(size);
+        *sl = (int)(size >> (t - SL_LOG2)) ^ SL_COUNT;
+        *fl = t - (FL_SHIFT - 1);
+    }
+}
+
+// First list whose blocks are all at least `size` bytes: round up to the
+// next list boundary, so any block found fits without walking the list
+static void mapping_search(size_t size, int* fl, int* sl) {
+    if (size >= (1 << FL_SHIFT)) {
+        size += ((size_t)1 << (fls64(size) - SL_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+static void free_list_insert(block_t* block) {
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    block->prev_free = NULL;
+    block->next_free = free_lists[fl][sl];
+    if (block->next_free) block->next_free->prev_free = block;
+    free_lists[fl][sl] = block;
+    fl_bitmap |= (uint64_t)1 << fl;
+    sl_bitmap[fl] |= 1u << sl;
+}
+
+static void free_list_remove(block_t* block) {
+    int fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+    if (block->prev_free) block->prev_free->next_free = block->next_free;
+    else free_lists[fl][sl] = block->next_free;
+    if (block->next_free) block->next_free->prev_free = block->prev_free;
+    if (!free_lists[fl][sl]) {
+        sl_bitmap[fl] &= ~(1u << sl);
+        if (!sl_bitmap[fl]) fl_bitmap &= ~((uint64_t)1 << fl);
+    }
+}
+
+// Take a free block of at least `size` bytes off its list
+static block_t* free_list_find(size_t size) {
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= FL_COUNT) return NULL;
+    
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint64_t fl_map = fl + 1 < FL_COUNT ? fl_bitmap & (~(uint64_t)0 << (fl + 1)) : 0;
+        if (!fl_map) return NULL;
+        fl = __builtin_ctzll(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    block_t* block = free_lists[fl][sl];
+    free_list_remove(block);
+    return block;
+}
+
+// Mark a block free or used, keeping the next block's tag in step
+static void block_set_free(block_t* block, bool is_free) {
+    block_t* next = block_next(block);
+    if (is_free) {
+        block->size |= BLOCK_FREE;
+        next->size |= BLOCK_PREV_FREE;
+        next->prev_phys = block;
+    } else {
+        block->size &= ~(size_t)BLOCK_FREE;
+        next->size &= ~(size_t)BLOCK_PREV_FREE;
+    }
+}
+
+// Cut `block` (off any list) down to `size` bytes; a remainder big enough to
+// stand alone goes back on the free lists
+static void block_trim(block_t* block, size_t size) {
+    if (block_size(block) < size + BLOCK_HEADER + BLOCK_MIN) return;
+    block_t* rest = (block_t*)((uint8_t*)block_payload(block) + size);
+    rest->size = block_size(block) - size - BLOCK_HEADER;
+    block->size = size | (block->size & BLOCK_FLAGS);
+    if (block->size & BLOCK_FREE) {
+        rest->size |= BLOCK_PREV_FREE;
+        rest->prev_phys = block;
+    }
+    block_set_free(rest, true);
+    free_list_insert(rest);
+}
 
-static block_header_t* head = NULL;
+// Hand a whole region to the heap as one free block, closed off by a
+// zero-size used block so merging never runs past the end
+static void heap_add_region(void* mem, size_t bytes) {
+    heap_region_t* region = (heap_region_t*)mem;
+    region->next = regions;
+    region->size = bytes;
+    regions = region;
+    
+    block_t* block = (block_t*)(region + 1);
+    block->prev_phys = NULL;
+    block->size = bytes - sizeof(heap_region_t) - 2 * BLOCK_HEADER;
+    block_t* sentinel = block_next(block);
+    sentinel->size = 0;
+    block_set_free(block, true);
+    free_list_insert(block);
+}
+
+// No single free block of 2^order pages: assemble the region from smaller
+// blocks mapped back to back in the VMM window. Largest first, so each piece
+// lands at an offset aligned to its size and big ones still map with 2 MiB
+// pages. If memory runs out part way, whatever was gathered is still added.
+static bool heap_grow_scattered(int order) {
+    size_t bytes = (size_t)PMM_PAGE_SIZE << order;
+    uint8_t* base = (uint8_t*)vmm_alloc_va(bytes, VMM_LARGE_PAGE_SIZE);
+    if (!base) return false;
+    
+    size_t done = 0;
+    int piece = order - 1;
+    while (done < bytes && piece >= 0) {
+        uint64_t phys;
+        if (!pmm_alloc(piece, &phys)) {
+            piece--;
+            continue;
+        }
+        size_t piece_bytes = (size_t)PMM_PAGE_SIZE << piece;
+        if (!vmm_map(base + done, phys, piece_bytes, VMM_DATA)) {
+            pmm_free(phys);
+            break;
+        }
+        done += piece_bytes;
+    }
+    
+    if (done < bytes) vmm_free_va(base + done, bytes - done);
+    if (done == 0) return false;
+    heap_add_region(base, done);
+    return true;
+}
+
+// Get a region from the PMM big enough that free_list_find(size) succeeds
+static bool heap_grow(size_t size) {
+    // mapping_search() rounds up by at most a sixteenth; then the region
+    // header and the two block headers
+    size_t need = size + size / SL_COUNT + sizeof(heap_region_t) + 2 * BLOCK_HEADER;
+    int order = pmm_order_for(need);
+    if (order < 0) return false;
+    if (order < HEAP_GROW_ORDER) order = HEAP_GROW_ORDER;
+    
+    uint64_t phys;
+    if (!pmm_alloc(order, &phys)) return heap_grow_scattered(order);
+    size_t bytes = (size_t)PMM_PAGE_SIZE << order;
+    
+    // Map the region with 2 MiB pages of our own rather than rely on how the
+    // bootloader built the HHDM; the HHDM is the fallback
+    void* mem = vmm_map_phys(phys, bytes, VMM_DATA);
+    heap_add_region(mem ? mem : pmm_to_virt(phys), bytes);
+    return true;
+}
+
+static block_t* free_list_take(size_t size) {
+    block_t* block = free_list_find(size);
+    if (!block && heap_grow(size)) block = free_list_find(size);
+    return block;
+}
 
 void memory_init() {
-    head = (block_header_t*)heap_data;
-    head->size = HEAP_SIZE - sizeof(block_header_t);
-    head->next = NULL;
-    head->is_free = 1;
+    slab_init();
 }
 
-void* malloc(size_t size) {
+static size_t heap_adjust(size_t size) {
+    size = (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+    return size < BLOCK_MIN ? BLOCK_MIN : size;
+}
+
+void* heap_alloc(size_t size) {
     if (size == 0) return NULL;
+    size = heap_adjust(size);
     
-    // Align size to 16 bytes
-    size_t aligned_size = (size + 15) & ~15;
+    block_t* block = free_list_take(size);
+    if (!block) return NULL; // OOM
+    block_trim(block, size);
+    block_set_free(block, false);
+    return block_payload(block);
+}
+
+void* heap_alloc_aligned(size_t size, size_t align) {
+    if (size == 0) return NULL;
+    if (align <= ALIGN) return heap_alloc(size);
+    size = heap_adjust(size);
     
-    block_header_t* curr = head;
-    while (curr) {
-        if (curr->is_free && curr->size >= aligned_size) {
-            // Found a block. Can we split it?
-            if (curr->size > aligned_size + sizeof(block_header_t) + 16) {
-                // Split
-                block_header_t* new_block = (block_header_t*)((uint8_t*)curr + sizeof(block_header_t) + aligned_size);
-                new_block->size = curr->size - aligned_size - sizeof(block_header_t);
-                new_block->is_free = 1;
-                new_block->next = curr->next;
-                
-                curr->size = aligned_size;
-                curr->next = new_block;
-            }
-            curr->is_free = 0;
-            return (void*)((uint8_t*)curr + sizeof(block_header_t));
-        }
-        curr = curr->next;
+    // Room for the block, the worst-case gap before the aligned address, and
+    // a free block to hold that gap
+    block_t* block = free_list_take(size + align + BLOCK_HEADER + BLOCK_MIN);
+    if (!block) return NULL; // OOM
+    
+    uintptr_t payload = (uintptr_t)block_payload(block);
+    uintptr_t aligned = (payload + align - 1) & ~(uintptr_t)(align - 1);
+    if (aligned != payload && aligned - payload < BLOCK_HEADER + BLOCK_MIN) aligned += align;
+    if (aligned != payload) {
+        // The gap in front stays free as a block of its own
+        block_t* front = block;
+        block = block_of((void*)aligned);
+        block->size = block_size(front) - (aligned - payload);
+        front->size = (aligned - payload - BLOCK_HEADER) | (front->size & BLOCK_FLAGS);
+        block_set_free(block, true);   // fixes up the block after it
+        block->size |= BLOCK_PREV_FREE;
+        block->prev_phys = front;
+        free_list_insert(front);
     }
-    return NULL; // OOM
+    block_trim(block, size);
+    block_set_free(block, false);
+    return block_payload(block);
 }
 
-void free(void* ptr) {
+void heap_free(void* ptr) {
     if (!ptr) return;
-    block_header_t* block = (block_header_t*)((uint8_t*)ptr - sizeof(block_header_t));
-    block->is_free = 1;
+    block_t* block = block_of(ptr);
     
-    // Merge only effectively next block for simplicity in this demo (Coalescing)
-    if (block->next && block->next->is_free) {
-        block->size += sizeof(block_header_t) + block->next->size;
-        block->next = block->next->next;
+    // Boundary tags make both neighbours reachable: merge with whichever is free
+    if (block->size & BLOCK_PREV_FREE) {
+        block_t* prev = block->prev_phys;
+        free_list_remove(prev);
+        prev->size += BLOCK_HEADER + block_size(block);
+        block = prev;
+    }
+    block_t* next = block_next(block);
+    if (next->size & BLOCK_FREE) {
+        free_list_remove(next);
+        block->size += BLOCK_HEADER + block_size(next);
+    }
+    block_set_free(block, true);
+    free_list_insert(block);
+}
+
+void heap_get_stats(heap_stats_t* out) {
+    out->total = 0;
+    out->free = 0;
+    out->largest_free = 0;
+    out->free_blocks = 0;
+    out->used_blocks = 0;
+    out->regions = 0;
+    for (heap_region_t* region = regions; region; region = region->next) {
+        out->total += region->size;
+        out->regions++;
+        for (block_t* block = (block_t*)(region + 1); block_size(block) != 0; block = block_next(block)) {
+            if (block->size & BLOCK_FREE) {
+                out->free += block_size(block);
+                if (block_size(block) > out->largest_free) out->largest_free = block_size(block);
+                out->free_blocks++;
+            } else {
+                out->used_blocks++;
+            }
+        }
     }
 }
 
-void* memset(void* ptr, int value, size_t num) {
-    unsigned char* p = ptr;
-    while (num--) *p++ = (unsigned char)value;
+// Small requests come from the slab caches in O(1); the rest from the heap
+void* malloc(size_t size) {
+    if (size == 0) return NULL;
+    void* ptr = size <= SLAB_MAX_SIZE ? slab_alloc(size) : NULL;
+    if (!ptr) ptr = heap_alloc(size);
+    if (ptr) trace_malloc(ptr, size);
     return ptr;
 }
 
-void* memcpy(void* dest, const void* src, size_t num) {
-    unsigned char* d = dest;
-    const unsigned char* s = src;
-    while (num--) *d++ = *s++;
-    return dest;
+void free(void* ptr) {
+    if (!ptr) return;
+    trace_free(ptr);
+    if (slab_owns(ptr)) {
+        slab_free(ptr);
+    } else {
+        heap_free(ptr);
+    }
 }
@@ -3,13 +3,28 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 void memory_init();
 void* malloc(size_t size);
 void free(void* ptr);
 
-// Standard utils
-void* memset(void* ptr, int value, size_t num);
-void* memcpy(void* dest, const void* src, size_t num);
+// The general heap underneath malloc(), for callers that manage their own
+// small objects (the slab caches) or need an aligned block. It grows on demand
+// with memory from the PMM, so pmm_init() must have run first.
+void* heap_alloc(size_t size);
+void* heap_alloc_aligned(size_t size, size_t align);
+void heap_free(void* ptr);
+// Walks every block, so only for diagnostics
+typedef struct {
+    size_t total;        // bytes managed, headers included
+    size_t free;         // payload bytes in free blocks
+    size_t largest_free; // largest single free block
+    int free_blocks;
+    int used_blocks;
+    int regions;         // taken from the PMM as the heap grew
+} heap_stats_t;
+
+void heap_get_stats(heap_stats_t* out);
 
 #endif
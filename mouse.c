@@ -1,9 +1,40 @@
 #include "mouse.h"
 #include "io.h"
+#include "idt.h"
+#include "pic.h"
+#include "timer.h"
+
+#define MOUSE_ACK 0xFA
+#define MOUSE_ID_INTELLIMOUSE 3
+
+// Counts per packet below which motion is passed through 1:1; above it the
+// gain grows with speed, in eighths, up to 4x
+#define MOUSE_ACCEL_THRESHOLD 4
+#define MOUSE_ACCEL_MAX_GAIN 32
 
 static mouse_state_t mouse_state;
+
+// Packet assembly, only touched by the IRQ12 handler (or with IRQ12 masked)
 static uint8_t mouse_cycle = 0;
-static int8_t mouse_byte[3];
+static uint8_t mouse_byte[4];
+static uint8_t packet_size = 3;
+
+// Single producer (the IRQ12 handler), single consumer (the main loop); see
+// the keyboard ring for the ordering argument
+static mouse_packet_t ring[MOUSE_RING_SIZE];
+static volatile uint32_t ring_head = 0; // next packet to fill, owned by the IRQ
+static volatile uint32_t ring_tail = 0; // next packet to take, owned by the main loop
+static volatile uint32_t dropped = 0;
+
+#define barrier() asm volatile ("" ::: "memory")
+
+// Pointer is clamped to [0, max_x] x [0, max_y]
+static int max_x = 799;
+static int max_y = 599;
+
+static int sample_rate = MOUSE_SAMPLE_RATE_DEFAULT;
+static int accel_level = 0;
+static int accel_rem_x = 0, accel_rem_y = 0; // eighths left over from scaling
 
 void mouse_wait(uint8_t type) {
     uint32_t timeout = 100000;
@@ -32,72 +63,210 @@ uint8_t mouse_read() {
     return inb(0x60);
 }
 
+// Send a command byte and wait for its acknowledgement. Stray packet bytes
+// that were already on their way are skipped.
+static bool mouse_command(uint8_t data) {
+    mouse_write(data);
+    for (int i = 0; i < 8; i++) {
+        if (mouse_read() == MOUSE_ACK) return true;
+    }
+    return false;
+}
+
+static bool mouse_command_rate(int rate) {
+    return mouse_command(0xF3) && mouse_command((uint8_t)rate);
+}
+
+// Size the pointer's range to the screen and park it in the middle
+void mouse_set_bounds(int width, int height) {
+    if (width < 1 || height < 1) return;
+    max_x = width - 1;
+    max_y = height - 1;
+    mouse_state.x = width / 2;
+    mouse_state.y = height / 2;
+}
+
+// Collect one byte per interrupt and queue each packet once it is whole
+__attribute__((interrupt))
+static void mouse_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    
+    // A request can still be latched in the PIC from while we polled with
+    // IRQ12 masked; only take a byte the controller says is the mouse's
+    if ((inb(0x64) & 0x21) != 0x21) {
+        pic_eoi(IRQ_MOUSE);
+        return;
+    }
+    uint8_t data = inb(0x60);
+    
+    // Bit 3 is always set in the first byte; anything else means we are out
+    // of step, so wait for the next packet start
+    if (mouse_cycle == 0 && !(data & 0x08)) {
+        pic_eoi(IRQ_MOUSE);
+        return;
+    }
+    mouse_byte[mouse_cycle++] = data;
+    
+    if (mouse_cycle == packet_size) {
+        mouse_cycle = 0;
+        uint32_t head = ring_head;
+        if (head - ring_tail < MOUSE_RING_SIZE) {
+            mouse_packet_t* packet = &ring[head & (MOUSE_RING_SIZE - 1)];
+            packet->timestamp = rdtsc();
+            packet->flags = mouse_byte[0];
+            packet->dx = mouse_byte[1];
+            packet->dy = mouse_byte[2];
+            packet->dz = packet_size == 4 ? mouse_byte[3] : 0;
+            barrier();
+            ring_head = head + 1;
+        } else {
+            dropped++;
+        }
+    }
+    pic_eoi(IRQ_MOUSE);
+}
+
 void mouse_init() {
-    mouse_state.x = 400;
-    mouse_state.y = 300;
+    mouse_state.x = (max_x + 1) / 2;
+    mouse_state.y = (max_y + 1) / 2;
     mouse_state.buttons = 0;
     
     // Enable auxiliary mouse device
     mouse_wait(1);
     outb(0x64, 0xA8);
     
-    // Enable interrupts
+    // Enable interrupts from both ports (IRQ1 and IRQ12)
     mouse_wait(1);
     outb(0x64, 0x20);
-    uint8_t status = mouse_read() | 2;
+    uint8_t status = mouse_read() | 3;
     mouse_wait(1);
     outb(0x64, 0x60);
     mouse_wait(1);
     outb(0x60, status);
     
     // Use default settings
-    mouse_write(0xF6);
-    mouse_read();
+    mouse_command(0xF6);
+    
+    // IntelliMouse knock: a wheel mouse answers the rate sequence 200, 100, 80
+    // by reporting ID 3 and sending a fourth packet byte from then on
+    mouse_command_rate(200);
+    mouse_command_rate(100);
+    mouse_command_rate(80);
+    if (mouse_command(0xF2) && mouse_read() == MOUSE_ID_INTELLIMOUSE) {
+        packet_size = 4;
+    }
+    mouse_command_rate(sample_rate);
     
     // Enable packet streaming
-    mouse_write(0xF4);
-    mouse_read();
-}
-
-void mouse_handle_interrupt() {
-    uint8_t status = inb(0x64);
-    if (!(status & 0x20)) return; // Not mouse data
-    
-    int8_t data = inb(0x60);
-    
-    switch (mouse_cycle) {
-        case 0:
-            mouse_byte[0] = data;
-            if (mouse_byte[0] & 0x08) mouse_cycle++; // Valid packet
-            break;
-        case 1:
-            mouse_byte[1] = data;
-            mouse_cycle++;
-            break;
-        case 2:
-            mouse_byte[2] = data;
-            mouse_cycle = 0;
-            
-            // Process packet
-            mouse_state.buttons = mouse_byte[0] & 0x07;
-            
-            int dx = mouse_byte[1];
-            int dy = mouse_byte[2];
-            
-            // Handle sign extension
-            if (mouse_byte[0] & 0x10) dx -= 256;
-            if (mouse_byte[0] & 0x20) dy -= 256;
-            
-            mouse_state.x += dx;
-            mouse_state.y -= dy; // Invert Y
-            
-            // Clamp to screen (assuming 800x600)
-            if (mouse_state.x < 0) mouse_state.x = 0;
-            if (mouse_state.x > 799) mouse_state.x = 799;
-            if (mouse_state.y < 0) mouse_state.y = 0;
-            if (mouse_state.y > 599) mouse_state.y = 599;
-            break;
+    mouse_command(0xF4);
+    
+    // Replies were polled above; from here on every byte arrives on IRQ12
+    mouse_cycle = 0;
+    idt_set_handler(PIC_IRQ_BASE + IRQ_MOUSE, (void*)mouse_irq);
+    pic_unmask(IRQ_MOUSE);
+}
+
+bool mouse_has_wheel() {
+    return packet_size == 4;
+}
+
+bool mouse_set_sample_rate(int rate) {
+    if (rate != 10 && rate != 20 && rate != 40 && rate != 60 &&
+        rate != 80 && rate != 100 && rate != 200) {
+        return false;
     }
+    
+    // Talk to the device by polling, with the handler kept out of the way.
+    // Streaming stops first so packets do not bury the acknowledgements.
+    pic_mask(IRQ_MOUSE);
+    bool ok = mouse_command(0xF5) && mouse_command_rate(rate);
+    mouse_command(0xF4);
+    mouse_cycle = 0;
+    pic_unmask(IRQ_MOUSE);
+    
+    if (ok) sample_rate = rate;
+    return ok;
+}
+
+int mouse_sample_rate() {
+    return sample_rate;
+}
+
+bool mouse_set_acceleration(int level) {
+    if (level < 0 || level > MOUSE_ACCEL_MAX) return false;
+    accel_level = level;
+    accel_rem_x = 0;
+    accel_rem_y = 0;
+    return true;
+}
+
+int mouse_acceleration() {
+    return accel_level;
+}
+
+bool mouse_next_packet(mouse_packet_t* out) {
+    uint32_t tail = ring_tail;
+    if (tail == ring_head) return false;
+    barrier();
+    *out = ring[tail & (MOUSE_RING_SIZE - 1)];
+    barrier();
+    ring_tail = tail + 1;
+    return true;
+}
+
+bool mouse_pending() {
+    return ring_tail != ring_head;
+}
+
+uint32_t mouse_dropped() {
+    return dropped;
+}
+
+// Slow movements stay exact for precise pointing; fast ones cover more of the
+// screen. Fractions are carried so a steady slow drift is not lost.
+static void mouse_accelerate(int* dx, int* dy) {
+    int speed = (*dx < 0 ? -*dx : *dx) + (*dy < 0 ? -*dy : *dy);
+    if (accel_level == 0 || speed <= MOUSE_ACCEL_THRESHOLD) return;
+    
+    int gain = 8 + accel_level * (speed - MOUSE_ACCEL_THRESHOLD);
+    if (gain > MOUSE_ACCEL_MAX_GAIN) gain = MOUSE_ACCEL_MAX_GAIN;
+    
+    int x = *dx * gain + accel_rem_x;
+    int y = *dy * gain + accel_rem_y;
+    *dx = x / 8;
+    *dy = y / 8;
+    accel_rem_x = x % 8;
+    accel_rem_y = y % 8;
+}
+
+void mouse_apply_packet(const mouse_packet_t* packet, int* moved_x, int* moved_y, int* wheel) {
+    mouse_state.buttons = packet->flags & 0x07;
+    
+    int dx = packet->dx;
+    int dy = packet->dy;
+    
+    // 9-bit two's complement: the sign bits live in the first byte
+    if (packet->flags & 0x10) dx -= 256;
+    if (packet->flags & 0x20) dy -= 256;
+    mouse_accelerate(&dx, &dy);
+    
+    int old_x = mouse_state.x, old_y = mouse_state.y;
+    mouse_state.x += dx;
+    mouse_state.y -= dy; // Invert Y
+    
+    // Clamp to screen
+    if (mouse_state.x < 0) mouse_state.x = 0;
+    if (mouse_state.x > max_x) mouse_state.x = max_x;
+    if (mouse_state.y < 0) mouse_state.y = 0;
+    if (mouse_state.y > max_y) mouse_state.y = max_y;
+    
+    *moved_x = mouse_state.x - old_x;
+    *moved_y = mouse_state.y - old_y;
+    
+    // 4-bit two's complement; the device counts toward the user as positive
+    int dz = packet->dz & 0x0F;
+    if (dz & 0x08) dz -= 16;
+    *wheel = -dz;
 }
 
 mouse_state_t* mouse_get_state() {
@@ -2,6 +2,13 @@
 #define MOUSE_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+// Packets assembled by the IRQ12 handler wait here; must be a power of two
+#define MOUSE_RING_SIZE 64
+
+#define MOUSE_SAMPLE_RATE_DEFAULT 100
+#define MOUSE_ACCEL_MAX 3
 
 typedef struct {
     int x;
@@ -9,11 +16,44 @@ typedef struct {
     uint8_t buttons; // Bit 0: Left, Bit 1: Right, Bit 2: Middle
 } mouse_state_t;
 
+// One complete movement packet, as the device sent it
+typedef struct {
+    uint64_t timestamp; // TSC when the interrupt took the packet's last byte
+    uint8_t flags;      // buttons, sign and overflow bits
+    uint8_t dx, dy;
+    uint8_t dz;         // wheel, low nibble; 0 unless the wheel was negotiated
+} mouse_packet_t;
+
+// Set the device up (polled), switching it to IntelliMouse 4-byte packets
+// when it has a wheel, then take its packets on IRQ12
 void mouse_init();
+void mouse_set_bounds(int width, int height);
 void mouse_wait(uint8_t type);
 void mouse_write(uint8_t data);
 uint8_t mouse_read();
-void mouse_handle_interrupt();
 mouse_state_t* mouse_get_state();
 
+// Take the oldest received packet; false if there is none. Main loop only.
+bool mouse_next_packet(mouse_packet_t* out);
+bool mouse_pending();
+
+// Move the pointer and set the buttons from a packet. Returns the on-screen
+// movement, after acceleration and clamping, and the wheel steps (positive
+// away from the user).
+void mouse_apply_packet(const mouse_packet_t* packet, int* moved_x, int* moved_y, int* wheel);
+
+bool mouse_has_wheel();
+
+// Reports per second: 10, 20, 40, 60, 80, 100 or 200. False if the rate is
+// not one of those or the device did not accept it.
+bool mouse_set_sample_rate(int rate);
+int mouse_sample_rate();
+
+// Pointer acceleration, 0 (off, raw deltas) to MOUSE_ACCEL_MAX
+bool mouse_set_acceleration(int level);
+int mouse_acceleration();
+
+// Packets lost because the ring was full
+uint32_t mouse_dropped();
+
 #endif
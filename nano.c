@@ -2,12 +2,7 @@
 #include "graphics.h"
 #include "vfs.h"
 #include "memory.h"
-
-// External string helpers
-extern int strcmp(const char* s1, const char* s2);
-extern void strcpy(char* dest, const char* src);
-extern int strlen(const char* str);
-extern void strncpy(char* dest, const char* src, int n);
+#include "string.h"
 
 #define MAX_LINES 100
 #define MAX_LINE_LEN 256
@@ -17,6 +12,8 @@ typedef struct {
     int line_count;
     int cursor_line;
     int cursor_col;
+    int top_line;       // first line in view
+    bool follow_cursor; // bring the cursor into view on the next render
     char filename[256];
     bool modified;
     bool needs_redraw;
@@ -30,6 +27,8 @@ void nano_init() {
     nano.line_count = 1;
     nano.cursor_line = 0;
     nano.cursor_col = 0;
+    nano.top_line = 0;
+    nano.follow_cursor = true;
     nano.filename[0] = '\0';
     nano.modified = false;
     nano.needs_redraw = true;
@@ -109,6 +108,7 @@ void nano_save() {
 
 void nano_handle_key(char c) {
     if (!nano.is_active) return;
+    nano.follow_cursor = true;
     
     if (c == 15) { // Ctrl+O - Save
         nano_save();
@@ -121,9 +121,8 @@ void nano_handle_key(char c) {
         // Enter - new line
         if (nano.line_count < MAX_LINES) {
             // Shift lines down
-            for (int i = nano.line_count; i > nano.cursor_line + 1; i--) {
-                strcpy(nano.lines[i], nano.lines[i - 1]);
-            }
+            memmove(nano.lines[nano.cursor_line + 2], nano.lines[nano.cursor_line + 1],
+                    (nano.line_count - nano.cursor_line - 1) * MAX_LINE_LEN);
             
             // Split current line
             strcpy(nano.lines[nano.cursor_line + 1], &nano.lines[nano.cursor_line][nano.cursor_col]);
@@ -154,9 +153,8 @@ void nano_handle_key(char c) {
                 strcpy(&nano.lines[nano.cursor_line - 1][prev_len], nano.lines[nano.cursor_line]);
                 
                 // Shift lines up
-                for (int i = nano.cursor_line; i < nano.line_count - 1; i++) {
-                    strcpy(nano.lines[i], nano.lines[i + 1]);
-                }
+                memmove(nano.lines[nano.cursor_line], nano.lines[nano.cursor_line + 1],
+                        (nano.line_count - nano.cursor_line - 1) * MAX_LINE_LEN);
                 
                 nano.line_count--;
                 nano.cursor_line--;
@@ -185,36 +183,51 @@ void nano_handle_key(char c) {
 void nano_render(int win_x, int win_y, int win_w, int win_h) {
     if (!nano.needs_redraw) return;
     
-    int content_x = win_x + 12;
-    int content_y = win_y + 40;
-    int content_w = win_w - 24;
-    int content_h = win_h - 70;
+    int content_x = win_x + ui_px(12);
+    int content_y = win_y + ui_px(40);
+    int content_w = win_w - ui_px(24);
+    int char_w = graphics_char_width();
+    int char_h = graphics_char_height();
+    int line_height = char_h + ui_px(4);
+    int content_h = win_h - ui_px(46) - 2 * line_height; // leaves room for the two status lines
+    
+    // Nano owns everything below the title bar; the window keeps it between redraws
+    draw_rect(win_x + 1, win_y + ui_px(28), win_w - 2, win_h - ui_px(28) - 1, COLOR_TERMINAL);
     
-    int line_height = 12;
     int max_visible = content_h / line_height;
+    int max_cols = content_w / char_w;
     
-    // Determine visible range
-    int start_line = 0;
-    if (nano.cursor_line >= max_visible) {
-        start_line = nano.cursor_line - max_visible + 1;
+    // Determine visible range: scroll as little as it takes to show the
+    // cursor after an edit, otherwise stay where the wheel left the view
+    if (nano.follow_cursor) {
+        if (nano.cursor_line < nano.top_line) nano.top_line = nano.cursor_line;
+        if (nano.cursor_line >= nano.top_line + max_visible) {
+            nano.top_line = nano.cursor_line - max_visible + 1;
+        }
+        nano.follow_cursor = false;
     }
+    if (nano.top_line > nano.line_count - max_visible) nano.top_line = nano.line_count - max_visible;
+    if (nano.top_line < 0) nano.top_line = 0;
+    int start_line = nano.top_line;
     
     // Draw lines
     int y = content_y;
     for (int i = start_line; i < nano.line_count && i < start_line + max_visible; i++) {
-        draw_string(content_x, y, nano.lines[i], 0xFFFFFFFF);
+        int len = strlen(nano.lines[i]);
+        if (len > max_cols) len = max_cols;
+        draw_text_run(content_x, y, nano.lines[i], len, 0xFFFFFFFF, COLOR_TRANSPARENT);
         y += line_height;
     }
     
     // Draw cursor
     int cursor_y = content_y + (nano.cursor_line - start_line) * line_height;
-    int cursor_x = content_x + (nano.cursor_col * 8);
+    int cursor_x = content_x + (nano.cursor_col * char_w);
     if (cursor_y >= content_y && cursor_y < content_y + content_h) {
-        draw_rect(cursor_x, cursor_y, 2, 10, 0xFFFFFFFF);
+        draw_rect(cursor_x, cursor_y, ui_px(2), char_h + ui_px(2), 0xFFFFFFFF);
     }
     
     // Draw status bar
-    int status_y = win_y + win_h - 24;
+    int status_y = win_y + win_h - 2 * line_height;
     char status[256];
     
     // Filename and modified indicator
@@ -242,7 +255,7 @@ void nano_render(int win_x, int win_y, int win_w, int win_h) {
     draw_string(content_x, status_y, status, 0xFFFFFF00); // Yellow
     
     // Help text
-    draw_string(content_x, status_y + 12, "^O Save  ^X Exit", 0xFF888888);
+    draw_string(content_x, status_y + line_height, "^O Save  ^X Exit", 0xFF888888);
     
     nano.needs_redraw = false;
 }
@@ -251,6 +264,18 @@ bool nano_needs_redraw() {
     return nano.needs_redraw;
 }
 
+void nano_set_dirty() {
+    nano.needs_redraw = true;
+}
+
+void nano_scroll(int lines) {
+    // Clamped against the window height in nano_render()
+    nano.top_line -= lines;
+    if (nano.top_line < 0) nano.top_line = 0;
+    if (nano.top_line > nano.line_count - 1) nano.top_line = nano.line_count - 1;
+    nano.needs_redraw = true;
+}
+
 bool nano_is_active() {
     return nano.is_active;
 }
@@ -8,6 +8,10 @@ void nano_open(char* filename);
 void nano_handle_key(char c);
 void nano_render(int win_x, int win_y, int win_w, int win_h);
 bool nano_needs_redraw();
+void nano_set_dirty();
+
+// Move the view without moving the cursor; positive goes toward the top
+void nano_scroll(int lines);
 bool nano_is_active();
 void nano_close();
 
@@ -0,0 +1,42 @@
+#include "pat.h"
+#include "cpu.h"
+#include "vmm.h"
+
+#define MSR_PAT 0x277
+
+// Same layout Limine uses: WB, WT, UC-, UC, WP, WC, UC-, UC. vmm.c selects
+// entries 0, 3 and 5 for VMM_WB, VMM_UC and VMM_WC.
+#define PAT_VALUE 0x0007010500070406ull
+
+pat_status_t pat_status;
+
+static void flush_caches_and_tlb() {
+    uint64_t cr3;
+    asm volatile ("wbinvd" ::: "memory");
+    asm volatile ("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+}
+
+// Program the PAT MSR. Every x86-64 CPU should have PAT; without it we leave the
+// bootloader's mappings alone and the framebuffer keeps whatever type it had.
+bool pat_init() {
+    pat_status.supported = false;
+    pat_status.framebuffer_wc = false;
+    if (!cpu_has(CPU_FEATURE_PAT)) return false;
+
+    asm volatile ("wbinvd" ::: "memory");
+    wrmsr(MSR_PAT, PAT_VALUE);
+    flush_caches_and_tlb();
+
+    pat_status.supported = true;
+    return true;
+}
+
+bool pat_map_write_combining(void* virt, size_t size) {
+    if (!pat_status.supported || size == 0) return false;
+
+    // Splits whatever large pages the bootloader used where the range only
+    // partly covers them
+    bool ok = vmm_protect(virt, size, VMM_DATA | VMM_WC);
+    pat_status.framebuffer_wc = ok;
+    return ok;
+}
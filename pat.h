@@ -0,0 +1,20 @@
+#ifndef PAT_H
+#define PAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    bool supported;             // CPU has PAT and the MSR was programmed
+    bool framebuffer_wc;        // Framebuffer pages now select the WC entry
+    uint32_t fill_mbps_before;  // Boot self-benchmark, bootloader attributes
+    uint32_t fill_mbps_after;   // Boot self-benchmark, after the remap
+} pat_status_t;
+
+extern pat_status_t pat_status;
+
+bool pat_init();
+bool pat_map_write_combining(void* virt, size_t size);
+
+#endif
@@ -0,0 +1,47 @@
+#include "pic.h"
+#include "io.h"
+
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA 0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA 0xA1
+
+#define ICW1_INIT 0x11  // edge triggered, cascade, ICW4 follows
+#define ICW4_8086 0x01
+#define PIC_EOI 0x20
+#define PIC_CASCADE_IRQ 2
+
+// Old PICs need a moment between initialization words
+static inline void io_wait() {
+    outb(0x80, 0);
+}
+
+void pic_init() {
+    outb(PIC1_COMMAND, ICW1_INIT); io_wait();
+    outb(PIC2_COMMAND, ICW1_INIT); io_wait();
+    outb(PIC1_DATA, PIC_IRQ_BASE); io_wait();      // ICW2: vector offsets
+    outb(PIC2_DATA, PIC_IRQ_BASE + 8); io_wait();
+    outb(PIC1_DATA, 1 << PIC_CASCADE_IRQ); io_wait(); // ICW3: slave on IRQ2
+    outb(PIC2_DATA, PIC_CASCADE_IRQ); io_wait();
+    outb(PIC1_DATA, ICW4_8086); io_wait();
+    outb(PIC2_DATA, ICW4_8086); io_wait();
+
+    // Everything masked except the cascade; drivers unmask what they handle
+    outb(PIC1_DATA, 0xFF & ~(1 << PIC_CASCADE_IRQ));
+    outb(PIC2_DATA, 0xFF);
+}
+
+void pic_unmask(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+void pic_mask(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+void pic_eoi(uint8_t irq) {
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+}
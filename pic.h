@@ -0,0 +1,18 @@
+#ifndef PIC_H
+#define PIC_H
+
+#include <stdint.h>
+
+// IRQ 0-15 are delivered on these vectors once the PICs are remapped
+#define PIC_IRQ_BASE 0x20
+#define IRQ_TIMER 0
+#define IRQ_KEYBOARD 1
+#define IRQ_MOUSE 12
+
+// Remap both 8259s above the CPU exceptions, with every IRQ masked
+void pic_init();
+void pic_unmask(uint8_t irq);
+void pic_mask(uint8_t irq);
+void pic_eoi(uint8_t irq);
+
+#endif
@@ -0,0 +1,163 @@
+#include "pmm.h"
+
+// One byte of state per page between the lowest and highest usable address.
+// Only the first page of a block says what the block is: the first page of
+// an allocated block holds just its order.
+#define PAGE_ORDER_MASK 0x1F
+#define PAGE_TAIL 0x20      // inside a block, not its first page
+#define PAGE_FREE 0x40      // first page of a free block, | order
+#define PAGE_RESERVED 0x80  // not usable memory, or the state array itself
+
+// Free blocks are linked through their own first page
+typedef struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+} free_block_t;
+
+uint64_t pmm_hhdm_offset = 0;
+
+static uint8_t* page_state = NULL;
+static uint64_t first_pfn = 0;
+static uint64_t page_count = 0;   // pages covered by page_state
+
+static free_block_t* free_lists[PMM_MAX_ORDER + 1];
+static uint64_t total_pages = 0;
+static uint64_t free_pages = 0;
+
+static inline uint8_t* state_of(uint64_t pfn) {
+    return &page_state[pfn - first_pfn];
+}
+
+static inline free_block_t* block_at(uint64_t pfn) {
+    return (free_block_t*)pmm_to_virt(pfn * PMM_PAGE_SIZE);
+}
+
+static void list_push(uint64_t pfn, int order) {
+    free_block_t* block = block_at(pfn);
+    block->prev = NULL;
+    block->next = free_lists[order];
+    if (block->next) block->next->prev = block;
+    free_lists[order] = block;
+    *state_of(pfn) = PAGE_FREE | order;
+    free_pages += 1ull << order;
+}
+
+static void list_remove(uint64_t pfn, int order) {
+    free_block_t* block = block_at(pfn);
+    if (block->prev) block->prev->next = block->next;
+    else free_lists[order] = block->next;
+    if (block->next) block->next->prev = block->prev;
+    *state_of(pfn) = PAGE_TAIL;
+    free_pages -= 1ull << order;
+}
+
+// Free a run of pages as the largest aligned blocks that fit
+static void add_range(uint64_t pfn, uint64_t end) {
+    total_pages += end - pfn;
+    while (pfn < end) {
+        int order = PMM_MAX_ORDER;
+        while (order > 0 && ((pfn & ((1ull << order) - 1)) || pfn + (1ull << order) > end)) order--;
+        for (uint64_t i = 1; i < (1ull << order); i++) *state_of(pfn + i) = PAGE_TAIL;
+        list_push(pfn, order);
+        pfn += 1ull << order;
+    }
+}
+
+bool pmm_init(struct limine_memmap_response* memmap, uint64_t hhdm_offset) {
+    pmm_hhdm_offset = hhdm_offset;
+    
+    // Span of usable memory, in whole pages
+    uint64_t lowest = UINT64_MAX, highest = 0;
+    for (uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if (entry->type != LIMINE_MEMMAP_USABLE) continue;
+        uint64_t start = (entry->base + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
+        uint64_t end = (entry->base + entry->length) / PMM_PAGE_SIZE;
+        if (start >= end) continue;
+        if (start < lowest) lowest = start;
+        if (end > highest) highest = end;
+    }
+    if (highest == 0) return false;
+    first_pfn = lowest;
+    page_count = highest - lowest;
+    
+    // The state array goes at the start of the first usable region big enough
+    uint64_t state_pages = (page_count + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
+    uint64_t state_pfn = 0;
+    for (uint64_t i = 0; i < memmap->entry_count && !page_state; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if (entry->type != LIMINE_MEMMAP_USABLE) continue;
+        uint64_t start = (entry->base + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
+        uint64_t end = (entry->base + entry->length) / PMM_PAGE_SIZE;
+        if (end > start && end - start >= state_pages) {
+            state_pfn = start;
+            page_state = (uint8_t*)pmm_to_virt(start * PMM_PAGE_SIZE);
+        }
+    }
+    if (!page_state) return false;
+    for (uint64_t i = 0; i < page_count; i++) page_state[i] = PAGE_RESERVED;
+    
+    for (uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if (entry->type != LIMINE_MEMMAP_USABLE) continue;
+        uint64_t start = (entry->base + PMM_PAGE_SIZE - 1) / PMM_PAGE_SIZE;
+        uint64_t end = (entry->base + entry->length) / PMM_PAGE_SIZE;
+        if (start == state_pfn) start += state_pages;
+        if (start < end) add_range(start, end);
+    }
+    return true;
+}
+
+bool pmm_alloc(int order, uint64_t* phys) {
+    if (order < 0 || order > PMM_MAX_ORDER) return false;
+    
+    int k = order;
+    while (k <= PMM_MAX_ORDER && !free_lists[k]) k++;
+    if (k > PMM_MAX_ORDER) return false;
+    
+    uint64_t pfn = pmm_to_phys(free_lists[k]) / PMM_PAGE_SIZE;
+    list_remove(pfn, k);
+    
+    // Split down to the requested size, freeing the upper halves
+    while (k > order) {
+        k--;
+        list_push(pfn + (1ull << k), k);
+    }
+    *state_of(pfn) = order;
+    *phys = pfn * PMM_PAGE_SIZE;
+    return true;
+}
+
+void pmm_free(uint64_t phys) {
+    uint64_t pfn = phys / PMM_PAGE_SIZE;
+    if (pfn < first_pfn || pfn >= first_pfn + page_count) return;
+    uint8_t state = *state_of(pfn);
+    if (state & (PAGE_TAIL | PAGE_FREE | PAGE_RESERVED)) return; // not an allocated block
+    
+    // Merge with the buddy for as long as it is free and whole
+    int order = state & PAGE_ORDER_MASK;
+    while (order < PMM_MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1ull << order);
+        if (buddy < first_pfn || buddy >= first_pfn + page_count) break;
+        if (*state_of(buddy) != (PAGE_FREE | order)) break;
+        list_remove(buddy, order);
+        *state_of(pfn) = PAGE_TAIL;
+        if (buddy < pfn) pfn = buddy;
+        order++;
+    }
+    list_push(pfn, order);
+}
+
+int pmm_order_for(size_t bytes) {
+    int order = 0;
+    while (order <= PMM_MAX_ORDER && ((size_t)PMM_PAGE_SIZE << order) < bytes) order++;
+    return order <= PMM_MAX_ORDER ? order : -1;
+}
+
+uint64_t pmm_total_pages() {
+    return total_pages;
+}
+
+uint64_t pmm_free_pages() {
+    return free_pages;
+}
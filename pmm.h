@@ -0,0 +1,38 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "limine.h"
+
+// Physical page allocator over every usable region of the Limine memory map.
+// A buddy system: blocks of 2^order pages, naturally aligned, with a free
+// list per order. Memory is reached through the HHDM, which maps it all.
+#define PMM_PAGE_SIZE 4096
+#define PMM_MAX_ORDER 16 // orders 0-16: blocks of 4 KiB up to 256 MiB
+
+bool pmm_init(struct limine_memmap_response* memmap, uint64_t hhdm_offset);
+
+// Allocate 2^order contiguous pages; returns false when no block is left
+bool pmm_alloc(int order, uint64_t* phys);
+void pmm_free(uint64_t phys);
+
+// Smallest order whose block holds `bytes`, or -1 if larger than PMM_MAX_ORDER
+int pmm_order_for(size_t bytes);
+
+static inline void* pmm_to_virt(uint64_t phys) {
+    extern uint64_t pmm_hhdm_offset;
+    return (void*)(phys + pmm_hhdm_offset);
+}
+
+static inline uint64_t pmm_to_phys(const void* virt) {
+    extern uint64_t pmm_hhdm_offset;
+    return (uint64_t)(uintptr_t)virt - pmm_hhdm_offset;
+}
+
+// Pages under management (usable memory), and those currently free
+uint64_t pmm_total_pages();
+uint64_t pmm_free_pages();
+
+#endif
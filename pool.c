@@ -0,0 +1,42 @@
+#include "pool.h"
+#include "memory.h"
+
+void pool_init(pool_t* pool, size_t object_size, int objects_per_chunk) {
+    // Free objects hold the free-list link, and every object stays 16-byte aligned
+    if (object_size < sizeof(void*)) object_size = sizeof(void*);
+    pool->object_size = (object_size + 15) & ~(size_t)15;
+    pool->objects_per_chunk = objects_per_chunk > 0 ? objects_per_chunk : 1;
+    pool->free_list = NULL;
+    pool->in_use = 0;
+    pool->capacity = 0;
+}
+
+// Take another chunk from the heap and thread its objects onto the free list
+static bool pool_grow(pool_t* pool) {
+    uint8_t* chunk = (uint8_t*)malloc(pool->object_size * pool->objects_per_chunk);
+    if (!chunk) return false;
+
+    for (int i = pool->objects_per_chunk - 1; i >= 0; i--) {
+        void** object = (void**)(chunk + (size_t)i * pool->object_size);
+        *object = pool->free_list;
+        pool->free_list = object;
+    }
+    pool->capacity += pool->objects_per_chunk;
+    return true;
+}
+
+void* pool_alloc(pool_t* pool) {
+    if (!pool->free_list && !pool_grow(pool)) return NULL;
+
+    void** object = (void**)pool->free_list;
+    pool->free_list = *object;
+    pool->in_use++;
+    return object;
+}
+
+void pool_free(pool_t* pool, void* object) {
+    if (!object) return;
+    *(void**)object = pool->free_list;
+    pool->free_list = object;
+    pool->in_use--;
+}
@@ -0,0 +1,22 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Fixed-size object pool. Objects are carved out of chunks taken from the heap
+// and recycled through a free list, so pool_alloc() and pool_free() are O(1) and
+// objects that come and go never fragment the heap. Chunks are never returned.
+typedef struct pool {
+    size_t object_size;
+    int objects_per_chunk;
+    void* free_list;
+    int in_use;        // objects handed out
+    int capacity;      // objects in all chunks
+} pool_t;
+
+void pool_init(pool_t* pool, size_t object_size, int objects_per_chunk);
+void* pool_alloc(pool_t* pool);
+void pool_free(pool_t* pool, void* object);
+
+#endif
@@ -0,0 +1,163 @@
+#include "profile.h"
+#include "timer.h"
+#include "graphics.h"
+
+// Rows of text are rebuilt this often; the panel itself is redrawn every frame
+#define HUD_REFRESH_FRAMES 15
+#define HUD_ROWS (PROF_SCOPE_COUNT + 1)
+#define HUD_COLUMNS 32
+
+static const char* scope_names[PROF_SCOPE_COUNT] = {
+    "frame", "input", "backgnd", "dock", "windows", "shell", "nano", "present"
+};
+
+static uint64_t scope_start[PROF_SCOPE_COUNT];
+static uint64_t scope_total[PROF_SCOPE_COUNT];
+
+// Per-scope rings of frame totals, in TSC cycles
+static uint64_t history[PROF_SCOPE_COUNT][PROF_HISTORY];
+static int history_head = 0;
+static int history_count = 0;
+
+static bool hud_visible = false;
+static int hud_age = HUD_REFRESH_FRAMES;
+static char hud_lines[HUD_ROWS][PROF_LINE_LEN];
+
+void profile_init() {
+    for (int s = 0; s < PROF_SCOPE_COUNT; s++) {
+        scope_total[s] = 0;
+    }
+    history_head = 0;
+    history_count = 0;
+    hud_visible = false;
+}
+
+void profile_begin(prof_scope_t scope) {
+    scope_start[scope] = rdtsc();
+}
+
+void profile_end(prof_scope_t scope) {
+    scope_total[scope] += rdtsc() - scope_start[scope];
+}
+
+void profile_frame_end() {
+    for (int s = 0; s < PROF_SCOPE_COUNT; s++) {
+        history[s][history_head] = scope_total[s];
+        scope_total[s] = 0;
+    }
+    history_head = (history_head + 1) % PROF_HISTORY;
+    if (history_count < PROF_HISTORY) history_count++;
+    hud_age++;
+}
+
+void profile_stats(prof_scope_t scope, prof_stats_t* out) {
+    // Sort a copy; 128 entries is cheap enough to do on demand
+    uint64_t sorted[PROF_HISTORY];
+    int n = history_count;
+    for (int i = 0; i < n; i++) {
+        uint64_t v = history[scope][i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    if (n == 0) {
+        out->last = out->p50 = out->p99 = out->max = 0;
+        return;
+    }
+    int last = (history_head + PROF_HISTORY - 1) % PROF_HISTORY;
+    out->last = timer_cycles_to_us(history[scope][last]);
+    out->p50 = timer_cycles_to_us(sorted[n / 2]);
+    out->p99 = timer_cycles_to_us(sorted[(n * 99) / 100]);
+    out->max = timer_cycles_to_us(sorted[n - 1]);
+}
+
+// Append `s` left-aligned in a field of `width` characters
+static char* put_field(char* out, const char* s, int width) {
+    int n = 0;
+    while (s[n]) *out++ = s[n++];
+    while (n++ < width) *out++ = ' ';
+    return out;
+}
+
+// Append `v` right-aligned in a field of `width` characters
+static char* put_uint(char* out, uint32_t v, int width) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    for (int pad = width - n; pad > 0; pad--) *out++ = ' ';
+    while (n) *out++ = digits[--n];
+    return out;
+}
+
+bool profile_format_row(int row, char* out) {
+    if (row < 0 || row > PROF_SCOPE_COUNT) return false;
+
+    char* p = out;
+    if (row == 0) {
+        p = put_field(p, "us", 8);
+        p = put_field(p, "  last   p50   p99   max", 0);
+    } else {
+        prof_stats_t st;
+        profile_stats((prof_scope_t)(row - 1), &st);
+        p = put_field(p, scope_names[row - 1], 8);
+        p = put_uint(p, st.last, 6);
+        p = put_uint(p, st.p50, 6);
+        p = put_uint(p, st.p99, 6);
+        p = put_uint(p, st.max, 6);
+    }
+    *p = '\0';
+    return true;
+}
+
+static void hud_rect(int* x, int* y, int* w, int* h) {
+    int pad = ui_px(6);
+    *w = HUD_COLUMNS * graphics_char_width() + 2 * pad;
+    *h = HUD_ROWS * (graphics_char_height() + ui_px(2)) + 2 * pad;
+    *x = graphics_width() - *w - ui_px(8);
+    *y = ui_px(TOPBAR_HEIGHT) + ui_px(8);
+}
+
+void profile_set_hud(bool visible) {
+    if (hud_visible && !visible) {
+        // Give the area back to the wallpaper; windows repaint over it this frame
+        int x, y, w, h;
+        hud_rect(&x, &y, &w, &h);
+        draw_desktop_region(x, y, w, h);
+    }
+    hud_visible = visible;
+    hud_age = HUD_REFRESH_FRAMES;
+}
+
+bool profile_hud_visible() {
+    return hud_visible;
+}
+
+// Drawn last in the frame, on top of windows
+void profile_hud_render() {
+    if (!hud_visible) return;
+
+    if (hud_age >= HUD_REFRESH_FRAMES) {
+        for (int row = 0; row < HUD_ROWS; row++) {
+            profile_format_row(row, hud_lines[row]);
+        }
+        hud_age = 0;
+    }
+
+    int x, y, w, h;
+    hud_rect(&x, &y, &w, &h);
+    draw_rect(x, y, w, h, 0xFF1C1C1E);
+
+    int pad = ui_px(6);
+    int line_height = graphics_char_height() + ui_px(2);
+    for (int row = 0; row < HUD_ROWS; row++) {
+        uint32_t color = row == 0 ? 0xFF8E8E93 : 0xFF30D158;
+        draw_text_run(x + pad, y + pad + row * line_height, hud_lines[row], -1, color, 0xFF1C1C1E);
+    }
+}
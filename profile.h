@@ -0,0 +1,51 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Instrumented parts of a desktop frame. A scope may be entered several times
+// per frame; its time is summed.
+typedef enum {
+    PROF_FRAME,       // whole frame, excluding the wait for it
+    PROF_INPUT,
+    PROF_BACKGROUND,  // wallpaper repair, desktop and top bar redraws
+    PROF_DOCK,
+    PROF_WINDOWS,
+    PROF_SHELL,
+    PROF_NANO,
+    PROF_PRESENT,
+    PROF_SCOPE_COUNT
+} prof_scope_t;
+
+// Frames of history kept per scope for the percentiles
+#define PROF_HISTORY 128
+
+// Microseconds, over the frames recorded so far (at most PROF_HISTORY)
+typedef struct {
+    uint32_t last;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} prof_stats_t;
+
+void profile_init();
+void profile_begin(prof_scope_t scope);
+void profile_end(prof_scope_t scope);
+
+// Close the current frame: push each scope's total into its ring
+void profile_frame_end();
+
+void profile_stats(prof_scope_t scope, prof_stats_t* out);
+
+// One formatted row of the statistics table; row 0 is the header.
+// Returns false past the last row. `out` must hold PROF_LINE_LEN bytes.
+#define PROF_LINE_LEN 48
+bool profile_format_row(int row, char* out);
+
+// On-screen overlay in the top right corner
+void profile_set_hud(bool visible);
+bool profile_hud_visible();
+void profile_hud_render();
+
+#endif
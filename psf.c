@@ -0,0 +1,82 @@
+#include "psf.h"
+#include "font.h"
+
+#define PSF1_MAGIC0 0x36
+#define PSF1_MAGIC1 0x04
+#define PSF1_MODE_512 0x01
+
+#define PSF2_MAGIC 0x864AB572
+
+typedef struct {
+    uint8_t magic[2];
+    uint8_t mode;
+    uint8_t charsize;
+} __attribute__((packed)) psf1_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t flags;
+    uint32_t glyph_count;
+    uint32_t bytes_per_glyph;
+    uint32_t height;
+    uint32_t width;
+} __attribute__((packed)) psf2_header_t;
+
+static const font_t builtin = {
+    .width = 8,
+    .height = 8,
+    .glyph_count = 128,
+    .bytes_per_row = 1,
+    .bytes_per_glyph = 8,
+    .bitmap = &font8x8_basic[0][0],
+};
+
+const font_t* font_builtin() {
+    return &builtin;
+}
+
+// The Unicode table that may follow the glyphs is ignored: characters index
+// glyphs directly, which matches ASCII for the usual console fonts
+bool psf_load(const void* data, size_t size, font_t* out) {
+    if (!data || !out) return false;
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    if (size >= sizeof(psf1_header_t) && bytes[0] == PSF1_MAGIC0 && bytes[1] == PSF1_MAGIC1) {
+        const psf1_header_t* hdr = (const psf1_header_t*)data;
+        int count = (hdr->mode & PSF1_MODE_512) ? 512 : 256;
+        if (hdr->charsize == 0 || hdr->charsize > PSF_MAX_HEIGHT) return false;
+        if (sizeof(psf1_header_t) + (size_t)count * hdr->charsize > size) return false;
+
+        out->width = 8;
+        out->height = hdr->charsize;
+        out->glyph_count = count;
+        out->bytes_per_row = 1;
+        out->bytes_per_glyph = hdr->charsize;
+        out->bitmap = bytes + sizeof(psf1_header_t);
+        return true;
+    }
+
+    if (size >= sizeof(psf2_header_t) && *(const uint32_t*)data == PSF2_MAGIC) {
+        const psf2_header_t* hdr = (const psf2_header_t*)data;
+        if (hdr->width == 0 || hdr->width > PSF_MAX_WIDTH) return false;
+        if (hdr->height == 0 || hdr->height > PSF_MAX_HEIGHT) return false;
+        if (hdr->glyph_count == 0) return false;
+
+        uint32_t row_bytes = (hdr->width + 7) / 8;
+        if (hdr->bytes_per_glyph < row_bytes * hdr->height) return false;
+        if (hdr->header_size > size) return false;
+        if ((uint64_t)hdr->glyph_count * hdr->bytes_per_glyph > size - hdr->header_size) return false;
+
+        out->width = hdr->width;
+        out->height = hdr->height;
+        out->glyph_count = hdr->glyph_count;
+        out->bytes_per_row = row_bytes;
+        out->bytes_per_glyph = hdr->bytes_per_glyph;
+        out->bitmap = bytes + hdr->header_size;
+        return true;
+    }
+
+    return false;
+}
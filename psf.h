@@ -0,0 +1,29 @@
+#ifndef PSF_H
+#define PSF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A monochrome bitmap font. Each glyph is `height` rows of `bytes_per_row`
+// bytes, most significant bit leftmost, as in the PC Screen Font formats.
+typedef struct {
+    int width, height;
+    int glyph_count;
+    int bytes_per_row;
+    int bytes_per_glyph;
+    const uint8_t* bitmap;
+} font_t;
+
+// Largest glyph cell accepted from a PSF file
+#define PSF_MAX_WIDTH 32
+#define PSF_MAX_HEIGHT 64
+
+// The 8x8 font compiled into the kernel
+const font_t* font_builtin();
+
+// Parse a PSF1 or PSF2 image in place. `out` points into `data`, which must
+// stay mapped. Returns false if the image is not a usable font.
+bool psf_load(const void* data, size_t size, font_t* out);
+
+#endif
@@ -0,0 +1,162 @@
+#include "scanout.h"
+#include "blit.h"
+
+typedef uint32_t v4u32 __attribute__((vector_size(16), may_alias));
+
+// Layout of the masks for the generic fallback, set by scanout_select()
+static struct limine_framebuffer* generic_fb = NULL;
+
+static void scanout_xrgb8888(void* dst, const uint32_t* src, size_t count) {
+    span_copy_stream((uint32_t*)dst, src, count);
+}
+
+static inline uint32_t swap_rb(uint32_t p) {
+    return ((p & 0xFF) << 16) | (p & 0xFF00) | ((p >> 16) & 0xFF);
+}
+
+__attribute__((target("sse2")))
+static void scanout_xbgr8888(void* dst, const uint32_t* src, size_t count) {
+    uint32_t* d = (uint32_t*)dst;
+    const v4u32 lo = { 0xFF, 0xFF, 0xFF, 0xFF };
+    const v4u32 mid = { 0xFF00, 0xFF00, 0xFF00, 0xFF00 };
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        v4u32 p;
+        __builtin_memcpy(&p, src + i, 16);
+        v4u32 out = ((p & lo) << 16) | (p & mid) | ((p >> 16) & lo);
+        __builtin_memcpy(d + i, &out, 16);
+    }
+    for (; i < count; i++) {
+        d[i] = swap_rb(src[i]);
+    }
+}
+
+// 24 bpp: four pixels pack into three 32-bit words
+static inline void pack_888(uint8_t* d, uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3) {
+    uint32_t w0 = (p0 & 0xFFFFFF) | (p1 << 24);
+    uint32_t w1 = ((p1 >> 8) & 0xFFFF) | (p2 << 16);
+    uint32_t w2 = ((p2 >> 16) & 0xFF) | (p3 << 8);
+    __builtin_memcpy(d, &w0, 4);
+    __builtin_memcpy(d + 4, &w1, 4);
+    __builtin_memcpy(d + 8, &w2, 4);
+}
+
+static void scanout_rgb888(void* dst, const uint32_t* src, size_t count) {
+    uint8_t* d = (uint8_t*)dst;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, d += 12) {
+        pack_888(d, src[i], src[i + 1], src[i + 2], src[i + 3]);
+    }
+    for (; i < count; i++, d += 3) {
+        d[0] = src[i];
+        d[1] = src[i] >> 8;
+        d[2] = src[i] >> 16;
+    }
+}
+
+static void scanout_bgr888(void* dst, const uint32_t* src, size_t count) {
+    uint8_t* d = (uint8_t*)dst;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, d += 12) {
+        pack_888(d, swap_rb(src[i]), swap_rb(src[i + 1]), swap_rb(src[i + 2]), swap_rb(src[i + 3]));
+    }
+    for (; i < count; i++, d += 3) {
+        d[0] = src[i] >> 16;
+        d[1] = src[i] >> 8;
+        d[2] = src[i];
+    }
+}
+
+static inline uint32_t to_rgb565(uint32_t p) {
+    return ((p >> 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 3) & 0x001F);
+}
+
+static inline uint32_t to_bgr565(uint32_t p) {
+    return ((p << 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 19) & 0x001F);
+}
+
+// 16 bpp: two pixels per 32-bit store
+static void scanout_rgb565(void* dst, const uint32_t* src, size_t count) {
+    uint16_t* d = (uint16_t*)dst;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        uint32_t pair = to_rgb565(src[i]) | (to_rgb565(src[i + 1]) << 16);
+        __builtin_memcpy(d + i, &pair, 4);
+    }
+    if (i < count) d[i] = to_rgb565(src[i]);
+}
+
+static void scanout_bgr565(void* dst, const uint32_t* src, size_t count) {
+    uint16_t* d = (uint16_t*)dst;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        uint32_t pair = to_bgr565(src[i]) | (to_bgr565(src[i + 1]) << 16);
+        __builtin_memcpy(d + i, &pair, 4);
+    }
+    if (i < count) d[i] = to_bgr565(src[i]);
+}
+
+// Any other RGB layout the firmware hands us: slower, but still chosen only once
+static void scanout_generic(void* dst, const uint32_t* src, size_t count) {
+    struct limine_framebuffer* fb = generic_fb;
+    size_t bytes = (fb->bpp + 7) / 8;
+    uint8_t* d = (uint8_t*)dst;
+
+    for (size_t i = 0; i < count; i++, d += bytes) {
+        uint32_t p = src[i];
+        uint32_t r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF;
+        uint32_t out = ((r >> (8 - fb->red_mask_size)) << fb->red_mask_shift)
+                     | ((g >> (8 - fb->green_mask_size)) << fb->green_mask_shift)
+                     | ((b >> (8 - fb->blue_mask_size)) << fb->blue_mask_shift);
+        for (size_t k = 0; k < bytes; k++) {
+            d[k] = out >> (8 * k);
+        }
+    }
+}
+
+static const scanout_format_t formats[] = {
+    { "XRGB8888", 32, 16, 8, 0, 8, 8, 8, scanout_xrgb8888 },
+    { "XBGR8888", 32, 0, 8, 16, 8, 8, 8, scanout_xbgr8888 },
+    { "RGB888",   24, 16, 8, 0, 8, 8, 8, scanout_rgb888 },
+    { "BGR888",   24, 0, 8, 16, 8, 8, 8, scanout_bgr888 },
+    { "RGB565",   16, 11, 5, 0, 5, 6, 5, scanout_rgb565 },
+    { "BGR565",   16, 0, 5, 11, 5, 6, 5, scanout_bgr565 },
+};
+
+static scanout_format_t generic_format = { "generic", 0, 0, 0, 0, 0, 0, 0, scanout_generic };
+
+// Match the framebuffer's bpp and channel masks against the specialized formats.
+// Returns NULL if the layout cannot be driven at all (not RGB, or wider than 8 bits).
+const scanout_format_t* scanout_select(struct limine_framebuffer* fb) {
+    if (fb->memory_model != LIMINE_FRAMEBUFFER_RGB) return NULL;
+
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        const scanout_format_t* f = &formats[i];
+        if (f->bpp == fb->bpp &&
+            f->red_shift == fb->red_mask_shift && f->red_size == fb->red_mask_size &&
+            f->green_shift == fb->green_mask_shift && f->green_size == fb->green_mask_size &&
+            f->blue_shift == fb->blue_mask_shift && f->blue_size == fb->blue_mask_size) {
+            return f;
+        }
+    }
+
+    if (fb->bpp == 0 || fb->bpp > 32 ||
+        fb->red_mask_size > 8 || fb->green_mask_size > 8 || fb->blue_mask_size > 8) {
+        return NULL;
+    }
+    generic_fb = fb;
+    generic_format.bpp = fb->bpp;
+    generic_format.red_shift = fb->red_mask_shift;
+    generic_format.green_shift = fb->green_mask_shift;
+    generic_format.blue_shift = fb->blue_mask_shift;
+    generic_format.red_size = fb->red_mask_size;
+    generic_format.green_size = fb->green_mask_size;
+    generic_format.blue_size = fb->blue_mask_size;
+    return &generic_format;
+}
+
+// The back buffer's own layout: the only one we can draw into directly
+bool scanout_is_native(const scanout_format_t* format) {
+    return format && format->convert == scanout_xrgb8888;
+}
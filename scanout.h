@@ -0,0 +1,24 @@
+#ifndef SCANOUT_H
+#define SCANOUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "limine.h"
+
+// Writes `count` back-buffer pixels (32-bit xRGB) to framebuffer memory in its
+// native layout. One of these is chosen at init; there is no per-pixel format check.
+typedef void (*scanout_fn)(void* dst, const uint32_t* src, size_t count);
+
+typedef struct {
+    const char* name;
+    uint16_t bpp;
+    uint8_t red_shift, green_shift, blue_shift;
+    uint8_t red_size, green_size, blue_size;
+    scanout_fn convert;
+} scanout_format_t;
+
+const scanout_format_t* scanout_select(struct limine_framebuffer* fb);
+bool scanout_is_native(const scanout_format_t* format);
+
+#endif
@@ -0,0 +1,84 @@
+#include "serial.h"
+#include "io.h"
+
+#define COM1 0x3F8
+#define UART_DATA 0          // DLAB=0: transmit/receive
+#define UART_IER 1           // DLAB=0: interrupt enable
+#define UART_DLL 0           // DLAB=1: divisor low
+#define UART_DLH 1           // DLAB=1: divisor high
+#define UART_FCR 2
+#define UART_LCR 3
+#define UART_MCR 4
+#define UART_LSR 5
+#define UART_SCRATCH 7
+
+#define LCR_8N1 0x03
+#define LCR_DLAB 0x80
+#define FCR_ENABLE_CLEAR 0xC7  // enable, clear both FIFOs, 14-byte trigger
+#define MCR_DTR_RTS_OUT2 0x0B
+#define LSR_THR_EMPTY 0x20
+
+#define UART_FIFO_DEPTH 16
+#define BAUD_DIVISOR 1         // 115200 baud
+
+// Single producer (the kernel), single consumer (the timer interrupt). Each
+// side only ever writes its own index, so no lock is needed; the compiler
+// barrier orders the data against the index update, and x86 keeps stores in
+// order for the other side.
+static uint8_t ring[SERIAL_RING_SIZE];
+static volatile uint32_t ring_head = 0; // next byte to fill, owned by writer
+static volatile uint32_t ring_tail = 0; // next byte to send, owned by drain
+static bool present = false;
+
+#define barrier() asm volatile ("" ::: "memory")
+
+bool serial_init() {
+    outb(COM1 + UART_IER, 0x00);        // Polled; the timer drains us
+    outb(COM1 + UART_LCR, LCR_DLAB);
+    outb(COM1 + UART_DLL, BAUD_DIVISOR & 0xFF);
+    outb(COM1 + UART_DLH, BAUD_DIVISOR >> 8);
+    outb(COM1 + UART_LCR, LCR_8N1);
+    outb(COM1 + UART_FCR, FCR_ENABLE_CLEAR);
+    outb(COM1 + UART_MCR, MCR_DTR_RTS_OUT2);
+
+    // No UART: the port floats and the scratch register does not hold a value
+    outb(COM1 + UART_SCRATCH, 0x5A);
+    present = inb(COM1 + UART_SCRATCH) == 0x5A;
+    return present;
+}
+
+bool serial_present() {
+    return present;
+}
+
+bool serial_write(const void* data, size_t len) {
+    if (!present) return false;
+
+    uint32_t head = ring_head;
+    uint32_t used = head - ring_tail;
+    if (len > SERIAL_RING_SIZE - used) return false;
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        ring[(head + i) & (SERIAL_RING_SIZE - 1)] = bytes[i];
+    }
+    barrier();
+    ring_head = head + len;
+    return true;
+}
+
+void serial_drain() {
+    if (!present) return;
+    if (!(inb(COM1 + UART_LSR) & LSR_THR_EMPTY)) return;
+
+    // An empty holding register means the whole FIFO is free
+    uint32_t tail = ring_tail;
+    uint32_t head = ring_head;
+    barrier();
+    for (int n = 0; n < UART_FIFO_DEPTH && tail != head; n++) {
+        outb(COM1 + UART_DATA, ring[tail & (SERIAL_RING_SIZE - 1)]);
+        tail++;
+    }
+    barrier();
+    ring_tail = tail;
+}
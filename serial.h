@@ -0,0 +1,24 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Transmit ring size; must be a power of two
+#define SERIAL_RING_SIZE 16384
+
+// Program COM1 for 115200 8N1 with FIFOs. Returns false if no UART answers.
+bool serial_init();
+bool serial_present();
+
+// Queue bytes for transmission without waiting. Either all of `len` bytes
+// are queued or none are; returns false if the ring is too full.
+// Only one context may write.
+bool serial_write(const void* data, size_t len);
+
+// Move queued bytes into the UART FIFO while it has room. Called from the
+// timer interrupt; never waits on the line.
+void serial_drain();
+
+#endif
@@ -3,9 +3,21 @@
 #include "io.h"
 #include "vfs.h"
 #include "auth.h"
+#include "pat.h"
+#include "timer.h"
+#include "frame.h"
+#include "profile.h"
+#include "trace.h"
+#include "mouse.h"
+#include "input.h"
+#include "bench.h"
+#include "memory.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "string.h"
 
 // Configuration
-#define MAX_LINES 100
+#define MAX_LINES 2000 // scrollback, a ring: the oldest line goes first
 #define MAX_LINE_LEN 256
 #define MAX_INPUT_LEN 256
 #define MAX_HISTORY 20
@@ -13,8 +25,9 @@
 // Terminal state
 typedef struct {
     char lines[MAX_LINES][MAX_LINE_LEN];
+    int first_line; // ring slot of the oldest line
     int line_count;
-    int scroll_offset;
+    int scroll_offset; // lines scrolled back from the newest output
     
     char input[MAX_INPUT_LEN];
     int input_len;
@@ -34,52 +47,41 @@ static terminal_t term;
 char nano_requested_file[256];
 bool nano_requested = false;
 
-// String helpers
-int strcmp(const char* s1, const char* s2) {
-    while(*s1 && (*s1 == *s2)) { s1++; s2++; }
-    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+// Output formatting helpers: append to `out` and return the new end
+static char* fmt_str(char* out, const char* s) {
+    while (*s) *out++ = *s++;
+    *out = '\0';
+    return out;
 }
 
-int strlen(const char* str) {
-    int len = 0;
-    while (str[len]) len++;
-    return len;
+static char* fmt_uint(char* out, uint64_t v) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *out++ = digits[--n];
+    *out = '\0';
+    return out;
 }
 
-void strcpy(char* dest, const char* src) {
-    while ((*dest++ = *src++));
-}
-
-int strncmp(const char* s1, const char* s2, int n) {
-    while(n > 0 && *s1 && (*s1 == *s2)) {
-        s1++; s2++; n--;
-    }
-    if (n == 0) return 0;
-    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
-}
-
-void strncpy(char* dest, const char* src, int n) {
-    int i;
-    for (i = 0; i < n && src[i] != '\0'; i++) {
-        dest[i] = src[i];
-    }
-    for (; i < n; i++) {
-        dest[i] = '\0';
-    }
+// Output line `i`, counting from the oldest one kept
+static char* terminal_line(int i) {
+    return term.lines[(term.first_line + i) % MAX_LINES];
 }
 
 // Terminal functions
 void terminal_add_line(const char* line) {
-    if (term.line_count >= MAX_LINES) {
-        // Scroll: shift all lines up
-        for (int i = 0; i < MAX_LINES - 1; i++) {
-            strcpy(term.lines[i], term.lines[i + 1]);
-        }
-        term.line_count = MAX_LINES - 1;
+    if (term.line_count == MAX_LINES) {
+        // Full: the oldest line's slot takes the new one
+        term.first_line = (term.first_line + 1) % MAX_LINES;
+        term.line_count--;
     }
     
-    strncpy(term.lines[term.line_count], line, MAX_LINE_LEN - 1);
-    term.lines[term.line_count][MAX_LINE_LEN - 1] = '\0';
+    char* slot = terminal_line(term.line_count);
+    strncpy(slot, line, MAX_LINE_LEN - 1);
+    slot[MAX_LINE_LEN - 1] = '\0';
     term.line_count++;
     term.needs_redraw = true;
 }
@@ -121,8 +123,12 @@ void terminal_execute_command() {
         terminal_add_line("  ls, cd, pwd, mkdir, touch");
         terminal_add_line("  cat, rm, echo, clear");
         terminal_add_line("  whoami, uname, help, reboot");
+        terminal_add_line("  fbinfo, mem, fps, prof [hud], trace");
+        terminal_add_line("  mouse [rate N | accel N]");
+        terminal_add_line("  bench alloc|heap|mem");
     }
     else if (strcmp(term.input, "clear") == 0) {
+        term.first_line = 0;
         term.line_count = 0;
     }
     else if (strcmp(term.input, "ls") == 0) {
@@ -147,6 +153,163 @@ void terminal_execute_command() {
     else if (strcmp(term.input, "uname") == 0) {
         terminal_add_line("AquaOS 1.0 x86_64");
     }
+    else if (strcmp(term.input, "fbinfo") == 0) {
+        char line[MAX_LINE_LEN];
+        char* p = fmt_str(line, "Framebuffer: ");
+        p = fmt_uint(p, graphics_width());
+        p = fmt_str(p, "x");
+        p = fmt_uint(p, graphics_height());
+        p = fmt_str(p, " ");
+        fmt_str(p, graphics_format_name());
+        terminal_add_line(line);
+        
+        terminal_add_line(graphics_has_back_buffer() ? "Back buffer: yes" : "Back buffer: no (direct)");
+        if (!pat_status.supported) {
+            terminal_add_line("Caching: bootloader default (no PAT)");
+        } else {
+            terminal_add_line(pat_status.framebuffer_wc ? "Caching: write-combining (PAT)"
+                                                        : "Caching: bootloader default (remap failed)");
+        }
+        
+        p = fmt_str(line, "Fill: ");
+        p = fmt_uint(p, pat_status.fill_mbps_before);
+        p = fmt_str(p, " MB/s before, ");
+        p = fmt_uint(p, pat_status.fill_mbps_after);
+        fmt_str(p, " MB/s after");
+        terminal_add_line(line);
+        
+        const present_stats_t* stats = graphics_present_stats();
+        p = fmt_str(line, "UI scale: ");
+        p = fmt_uint(p, graphics_ui_scale());
+        p = fmt_str(p, "x, last present ");
+        p = fmt_uint(p, stats->pixels);
+        p = fmt_str(p, " px in ");
+        p = fmt_uint(p, timer_cycles_to_us(stats->cycles));
+        p = fmt_str(p, " us (peak ");
+        p = fmt_uint(p, timer_cycles_to_us(stats->peak_cycles));
+        fmt_str(p, " us)");
+        terminal_add_line(line);
+    }
+    else if (strcmp(term.input, "mem") == 0) {
+        char line[MAX_LINE_LEN];
+        char* p = fmt_str(line, "Physical: ");
+        p = fmt_uint(p, pmm_free_pages() * PMM_PAGE_SIZE / 1024);
+        p = fmt_str(p, " KiB free of ");
+        p = fmt_uint(p, pmm_total_pages() * PMM_PAGE_SIZE / 1024);
+        fmt_str(p, " KiB");
+        terminal_add_line(line);
+        
+        heap_stats_t heap;
+        heap_get_stats(&heap);
+        p = fmt_str(line, "Heap: ");
+        p = fmt_uint(p, heap.free / 1024);
+        p = fmt_str(p, " KiB free of ");
+        p = fmt_uint(p, heap.total / 1024);
+        p = fmt_str(p, " KiB in ");
+        p = fmt_uint(p, heap.regions);
+        fmt_str(p, " regions");
+        terminal_add_line(line);
+        
+        p = fmt_str(line, "Kernel VA: ");
+        p = fmt_uint(p, (VMM_WINDOW_SIZE - vmm_va_free()) / 1024);
+        p = fmt_str(p, " KiB reserved, largest free ");
+        p = fmt_uint(p, vmm_va_largest() >> 30);
+        fmt_str(p, " GiB");
+        terminal_add_line(line);
+    }
+    else if (strcmp(term.input, "fps") == 0 || strncmp(term.input, "fps ", 4) == 0) {
+        char line[MAX_LINE_LEN];
+        bool ok = true;
+        if (term.input[3] == ' ') {
+            int rate = 0;
+            for (char* d = term.input + 4; *d >= '0' && *d <= '9'; d++) {
+                rate = rate * 10 + (*d - '0');
+                if (rate > FRAME_RATE_MAX) break;
+            }
+            ok = frame_set_rate(rate);
+        }
+        if (ok) {
+            char* p = fmt_str(line, "Target ");
+            p = fmt_uint(p, frame_rate());
+            p = fmt_str(p, " Hz, measured ");
+            p = fmt_uint(p, frame_measured_rate());
+            fmt_str(p, " frames/s");
+        } else {
+            char* p = fmt_str(line, "fps: rate must be ");
+            p = fmt_uint(p, FRAME_RATE_MIN);
+            p = fmt_str(p, "-");
+            fmt_uint(p, FRAME_RATE_MAX);
+        }
+        terminal_add_line(line);
+    }
+    else if (strcmp(term.input, "prof") == 0) {
+        char line[PROF_LINE_LEN];
+        for (int row = 0; profile_format_row(row, line); row++) {
+            terminal_add_line(line);
+        }
+    }
+    else if (strcmp(term.input, "prof hud") == 0) {
+        profile_set_hud(!profile_hud_visible());
+        terminal_add_line(profile_hud_visible() ? "Profiler HUD on" : "Profiler HUD off");
+    }
+    else if (strcmp(term.input, "trace") == 0) {
+        if (!trace_enabled()) {
+            terminal_add_line("Trace: off (no COM1)");
+        } else {
+            char line[MAX_LINE_LEN];
+            char* p = fmt_str(line, "Trace: COM1, ");
+            p = fmt_uint(p, trace_dropped());
+            fmt_str(p, " records dropped");
+            terminal_add_line(line);
+        }
+    }
+    else if (strcmp(term.input, "mouse") == 0 || strncmp(term.input, "mouse ", 6) == 0) {
+        char line[MAX_LINE_LEN];
+        char* arg = term.input + 6;
+        bool ok = true;
+        if (term.input[5] == ' ') {
+            bool rate = strncmp(arg, "rate ", 5) == 0;
+            bool accel = strncmp(arg, "accel ", 6) == 0;
+            int value = 0;
+            for (char* d = arg + (rate ? 5 : 6); *d >= '0' && *d <= '9'; d++) {
+                value = value * 10 + (*d - '0');
+                if (value > 1000) break;
+            }
+            if (rate) {
+                ok = mouse_set_sample_rate(value);
+                if (!ok) terminal_add_line("mouse: rate must be 10, 20, 40, 60, 80, 100 or 200");
+            } else if (accel) {
+                ok = mouse_set_acceleration(value);
+                if (!ok) {
+                    char* p = fmt_str(line, "mouse: accel must be 0-");
+                    fmt_uint(p, MOUSE_ACCEL_MAX);
+                    terminal_add_line(line);
+                }
+            } else {
+                ok = false;
+                terminal_add_line("usage: mouse [rate N | accel N]");
+            }
+        }
+        if (ok) {
+            char* p = fmt_str(line, mouse_has_wheel() ? "Mouse: wheel, " : "Mouse: no wheel, ");
+            p = fmt_uint(p, mouse_sample_rate());
+            p = fmt_str(p, " reports/s, acceleration ");
+            p = fmt_uint(p, mouse_acceleration());
+            p = fmt_str(p, ", ");
+            p = fmt_uint(p, input_dropped());
+            fmt_str(p, " events dropped");
+            terminal_add_line(line);
+        }
+    }
+    else if (strcmp(term.input, "bench alloc") == 0) {
+        bench_alloc(terminal_add_line);
+    }
+    else if (strcmp(term.input, "bench heap") == 0) {
+        bench_heap(terminal_add_line);
+    }
+    else if (strcmp(term.input, "bench mem") == 0) {
+        bench_mem(terminal_add_line);
+    }
     else if (strncmp(term.input, "cd ", 3) == 0) {
         char* arg = term.input + 3;
         if (strcmp(arg, "..") == 0) {
@@ -184,7 +347,20 @@ void terminal_execute_command() {
         if (file && file->flags == FS_FILE) {
             char* content = vfs_read(file);
             if (content) {
-                terminal_add_line(content);
+                // One terminal line per file line, so long files can be scrolled
+                char line[MAX_LINE_LEN];
+                char* start = content;
+                for (;;) {
+                    char* end = start;
+                    while (*end != '\0' && *end != '\n') end++;
+                    int len = end - start;
+                    if (len > MAX_LINE_LEN - 1) len = MAX_LINE_LEN - 1;
+                    strncpy(line, start, len);
+                    line[len] = '\0';
+                    terminal_add_line(line);
+                    if (*end == '\0' || end[1] == '\0') break; // no empty line for a final newline
+                    start = end + 1;
+                }
             } else {
                 terminal_add_line("(empty file)");
             }
@@ -269,6 +445,7 @@ void terminal_execute_command() {
 }
 
 void shell_init() {
+    term.first_line = 0;
     term.line_count = 0;
     term.scroll_offset = 0;
     term.input[0] = '\0';
@@ -287,6 +464,12 @@ void shell_init() {
 }
 
 void shell_handle_key(char c) {
+    // Typing brings the prompt back into view
+    if (term.scroll_offset != 0) {
+        term.scroll_offset = 0;
+        term.needs_redraw = true;
+    }
+    
     if (c == '\n') {
         // Enter - execute command
         terminal_execute_command();
@@ -334,41 +517,56 @@ void shell_handle_key(char c) {
 }
 
 void shell_update(int win_x, int win_y, int win_w, int win_h) {
-    // Don't clear background - it stays black and stable
-    // Only draw text on top
-    
     // Calculate content area
-    int content_x = win_x + 12;
-    int content_y = win_y + 40;
-    int content_w = win_w - 24;
-    int content_h = win_h - 52;
+    int content_x = win_x + ui_px(12);
+    int content_y = win_y + ui_px(40);
+    int content_w = win_w - ui_px(24);
+    int content_h = win_h - ui_px(52);
+    
+    // The window keeps what was drawn last time; start from a clean background
+    draw_rect(content_x, content_y, content_w, content_h, COLOR_TERMINAL);
     
-    int line_height = 12;
+    int char_w = graphics_char_width();
+    int char_h = graphics_char_height();
+    int line_height = char_h + ui_px(4);
     int max_visible = (content_h - line_height) / line_height;
+    int max_cols = content_w / char_w;
     
-    // Determine which lines to show
+    // Determine which lines to show; the scrollback cannot go past the first line
     int start_line = 0;
     if (term.line_count > max_visible) {
-        start_line = term.line_count - max_visible;
+        if (term.scroll_offset > term.line_count - max_visible) {
+            term.scroll_offset = term.line_count - max_visible;
+        }
+        start_line = term.line_count - max_visible - term.scroll_offset;
+    } else {
+        term.scroll_offset = 0;
     }
     
     // Draw output lines
     int y = content_y;
     for (int i = start_line; i < term.line_count; i++) {
         if (y + line_height > content_y + content_h - line_height) break;
-        draw_string(content_x, y, term.lines[i], 0xFF00FF00); // Green
+        char* line = terminal_line(i);
+        int len = strlen(line);
+        if (len > max_cols) len = max_cols;
+        draw_text_run(content_x, y, line, len, 0xFF00FF00, COLOR_TERMINAL); // Green
         y += line_height;
     }
     
     // Draw prompt and input
     if (y + line_height <= content_y + content_h) {
-        draw_string(content_x, y, "> ", 0xFFFFFFFF);
-        draw_string(content_x + 16, y, term.input, 0xFFFFFFFF);
+        draw_text_run(content_x, y, "> ", 2, 0xFFFFFFFF, COLOR_TERMINAL);
+        int len = term.input_len;
+        if (len > max_cols - 2) len = max_cols - 2;
+        if (len > 0) {
+            draw_text_run(content_x + 2 * char_w, y, term.input, len, 0xFFFFFFFF, COLOR_TERMINAL);
+        }
         
         // Draw cursor
-        int cursor_x = content_x + 16 + (term.cursor_pos * 8);
-        if (cursor_x < content_x + content_w - 10) {
-            draw_rect(cursor_x, y, 2, 10, 0xFFFFFFFF);
+        int cursor_x = content_x + (2 + term.cursor_pos) * char_w;
+        if (cursor_x < content_x + content_w - ui_px(10)) {
+            draw_rect(cursor_x, y, ui_px(2), char_h + ui_px(2), 0xFFFFFFFF);
         }
     }
     
@@ -382,3 +580,13 @@ bool shell_needs_redraw() {
 void shell_set_dirty() {
     term.needs_redraw = true;
 }
+
+void shell_scroll(int lines) {
+    int offset = term.scroll_offset + lines;
+    if (offset < 0) offset = 0;
+    if (offset > term.line_count) offset = term.line_count; // refined by shell_update()
+    if (offset != term.scroll_offset) {
+        term.scroll_offset = offset;
+        term.needs_redraw = true;
+    }
+}
@@ -13,4 +13,7 @@ void shell_update(int win_x, int win_y, int win_w, int win_h);
 bool shell_needs_redraw();
 void shell_set_dirty();
 
+// Move the view through the scrollback; positive goes back to older lines
+void shell_scroll(int lines);
+
 #endif
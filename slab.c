@@ -0,0 +1,141 @@
+#include "slab.h"
+#include "memory.h"
+
+#define SLAB_MAGIC 0x51AB51AB
+#define SLAB_HEADER_SIZE 64 // chunk header, rounded so objects stay 16-byte aligned
+
+// Spaced about 1.5x apart, so no object wastes more than a third of its slot
+static const uint16_t class_sizes[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+#define SLAB_CLASSES (int)(sizeof(class_sizes) / sizeof(class_sizes[0]))
+
+// Header at the start of every chunk; an object's chunk is found by rounding
+// its address down to SLAB_CHUNK_SIZE
+typedef struct slab_chunk {
+    uint32_t magic;
+    uint16_t class_index;
+    uint16_t in_use;
+    struct slab_chunk* self;    // with the magic, tells a chunk from heap data
+    void* free_list;            // returned objects
+    uint8_t* bump;              // first object never handed out
+    uint8_t* end;
+    struct slab_chunk* prev;    // in the class's list of chunks with room
+    struct slab_chunk* next;
+} slab_chunk_t;
+
+typedef struct {
+    size_t object_size;
+    slab_chunk_t* partial;      // chunks with at least one free object
+} slab_class_t;
+
+static slab_class_t classes[SLAB_CLASSES];
+
+// Class for each size in 16-byte steps, so lookup is a table read
+static uint8_t class_for_size[SLAB_MAX_SIZE / 16 + 1];
+
+static int chunk_count = 0;
+
+void slab_init() {
+    int c = 0;
+    for (int i = 0; i <= SLAB_MAX_SIZE / 16; i++) {
+        while (class_sizes[c] < i * 16) c++;
+        class_for_size[i] = c;
+    }
+    for (int i = 0; i < SLAB_CLASSES; i++) {
+        classes[i].object_size = class_sizes[i];
+        classes[i].partial = NULL;
+    }
+    chunk_count = 0;
+}
+
+static void slab_link(slab_class_t* cls, slab_chunk_t* chunk) {
+    chunk->prev = NULL;
+    chunk->next = cls->partial;
+    if (cls->partial) cls->partial->prev = chunk;
+    cls->partial = chunk;
+}
+
+static void slab_unlink(slab_class_t* cls, slab_chunk_t* chunk) {
+    if (chunk->prev) chunk->prev->next = chunk->next;
+    else cls->partial = chunk->next;
+    if (chunk->next) chunk->next->prev = chunk->prev;
+}
+
+static bool slab_full(const slab_chunk_t* chunk, size_t object_size) {
+    return !chunk->free_list && chunk->bump + object_size > chunk->end;
+}
+
+// Objects are handed out from a bump pointer until the chunk has been used
+// once, so a new chunk costs nothing to set up
+static slab_chunk_t* slab_grow(int class_index) {
+    slab_chunk_t* chunk = (slab_chunk_t*)heap_alloc_aligned(SLAB_CHUNK_SIZE, SLAB_CHUNK_SIZE);
+    if (!chunk) return NULL;
+    chunk->magic = SLAB_MAGIC;
+    chunk->class_index = class_index;
+    chunk->in_use = 0;
+    chunk->self = chunk;
+    chunk->free_list = NULL;
+    chunk->bump = (uint8_t*)chunk + SLAB_HEADER_SIZE;
+    chunk->end = (uint8_t*)chunk + SLAB_CHUNK_SIZE;
+    slab_link(&classes[class_index], chunk);
+    chunk_count++;
+    return chunk;
+}
+
+void* slab_alloc(size_t size) {
+    if (size == 0 || size > SLAB_MAX_SIZE) return NULL;
+    int class_index = class_for_size[(size + 15) / 16];
+    slab_class_t* cls = &classes[class_index];
+    
+    slab_chunk_t* chunk = cls->partial;
+    if (!chunk && !(chunk = slab_grow(class_index))) return NULL;
+    
+    void* object;
+    if (chunk->free_list) {
+        object = chunk->free_list;
+        chunk->free_list = *(void**)object;
+    } else {
+        object = chunk->bump;
+        chunk->bump += cls->object_size;
+    }
+    chunk->in_use++;
+    if (slab_full(chunk, cls->object_size)) slab_unlink(cls, chunk);
+    return object;
+}
+
+static slab_chunk_t* slab_chunk_of(const void* ptr) {
+    return (slab_chunk_t*)((uintptr_t)ptr & ~(uintptr_t)(SLAB_CHUNK_SIZE - 1));
+}
+
+// Heap regions start 2 MiB aligned (in the VMM window or the HHDM), a
+// multiple of SLAB_CHUNK_SIZE, so rounding down never leaves the region the
+// pointer is in and the address is safe to read
+bool slab_owns(const void* ptr) {
+    slab_chunk_t* chunk = slab_chunk_of(ptr);
+    if ((const void*)chunk == ptr) return false;
+    return chunk->magic == SLAB_MAGIC && chunk->self == chunk;
+}
+
+void slab_free(void* ptr) {
+    slab_chunk_t* chunk = slab_chunk_of(ptr);
+    slab_class_t* cls = &classes[chunk->class_index];
+    
+    if (slab_full(chunk, cls->object_size)) slab_link(cls, chunk);
+    *(void**)ptr = chunk->free_list;
+    chunk->free_list = ptr;
+    chunk->in_use--;
+    
+    // Give an empty chunk back unless it is the class's last one, so a single
+    // object coming and going does not take a chunk from the heap each time
+    if (chunk->in_use == 0 && (chunk->prev || chunk->next)) {
+        slab_unlink(cls, chunk);
+        chunk->magic = 0; // the heap may reuse this address for anything
+        heap_free(chunk);
+        chunk_count--;
+    }
+}
+
+int slab_chunk_count() {
+    return chunk_count;
+}
@@ -0,0 +1,25 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Size-class caches for small allocations. Each class carves objects of one
+// size out of SLAB_CHUNK_SIZE chunks taken from the heap, so allocation and
+// free are O(1) however many objects are live. malloc() sends requests of up
+// to SLAB_MAX_SIZE bytes here.
+#define SLAB_MIN_SIZE 16
+#define SLAB_MAX_SIZE 2048
+#define SLAB_CHUNK_SIZE (64 * 1024) // also the chunk alignment
+
+void slab_init();
+void* slab_alloc(size_t size);
+void slab_free(void* ptr);
+
+// Whether `ptr` was handed out by slab_alloc()
+bool slab_owns(const void* ptr);
+
+// Chunks currently taken from the heap, over all classes
+int slab_chunk_count();
+
+#endif
@@ -0,0 +1,296 @@
+#include "string.h"
+#include "cpu.h"
+
+// Below this, rep movsb/stosb costs more to start than it saves and the
+// SSE2 loop is faster
+#define REP_MIN 2048
+
+typedef uint64_t word_t __attribute__((may_alias));
+typedef uint32_t half_t __attribute__((may_alias));
+typedef uint16_t quarter_t __attribute__((may_alias));
+typedef long long v2i64 __attribute__((vector_size(16), may_alias));
+
+#define ONES 0x0101010101010101ull
+#define HIGHS 0x8080808080808080ull
+
+static bool use_sse2 = false;
+static size_t rep_min = SIZE_MAX; // no ERMS: never
+
+void string_init() {
+    use_sse2 = cpu_has(CPU_FEATURE_SSE2);
+    rep_min = cpu_has(CPU_FEATURE_ERMS) ? REP_MIN : SIZE_MAX;
+}
+
+const char* string_copy_method() {
+    if (rep_min == REP_MIN) return "rep movsb (ERMS)";
+    return use_sse2 ? "SSE2" : "words";
+}
+
+// Nonzero if any byte of w is zero
+static inline word_t has_zero(word_t w) {
+    return (w - ONES) & ~w & HIGHS;
+}
+
+// A word read at p stays on p's page, so it cannot fault where a byte
+// read would not
+static inline bool word_in_page(const void* p) {
+    return ((uintptr_t)p & 4095) <= 4096 - sizeof(word_t);
+}
+
+static inline void copy_rep(void* dest, const void* src, size_t n) {
+    asm volatile ("rep movsb"
+                  : "+D"(dest), "+S"(src), "+c"(n)
+                  :
+                  : "memory");
+}
+
+static inline void fill_rep(void* dest, uint8_t value, size_t n) {
+    asm volatile ("rep stosb"
+                  : "+D"(dest), "+c"(n)
+                  : "a"(value)
+                  : "memory");
+}
+
+// Up to 16 bytes as two accesses that may overlap. Both loads happen before
+// either store, so this is safe for overlapping buffers too.
+static inline void copy_small(uint8_t* d, const uint8_t* s, size_t n) {
+    if (n >= 8) {
+        word_t a = *(const word_t*)s, b = *(const word_t*)(s + n - 8);
+        *(word_t*)d = a;
+        *(word_t*)(d + n - 8) = b;
+    } else if (n >= 4) {
+        half_t a = *(const half_t*)s, b = *(const half_t*)(s + n - 4);
+        *(half_t*)d = a;
+        *(half_t*)(d + n - 4) = b;
+    } else if (n >= 2) {
+        quarter_t a = *(const quarter_t*)s, b = *(const quarter_t*)(s + n - 2);
+        *(quarter_t*)d = a;
+        *(quarter_t*)(d + n - 2) = b;
+    } else if (n) {
+        *d = *s;
+    }
+}
+
+static inline void fill_small(uint8_t* d, word_t w, size_t n) {
+    if (n >= 8) {
+        *(word_t*)d = w;
+        *(word_t*)(d + n - 8) = w;
+    } else if (n >= 4) {
+        *(half_t*)d = (half_t)w;
+        *(half_t*)(d + n - 4) = (half_t)w;
+    } else if (n >= 2) {
+        *(quarter_t*)d = (quarter_t)w;
+        *(quarter_t*)(d + n - 2) = (quarter_t)w;
+    } else if (n) {
+        *d = (uint8_t)w;
+    }
+}
+
+// The forward copies below read the last word (or vector) up front and
+// store the first and last ones after the loop, so they are also correct
+// for overlapping buffers with dest below src, which memmove() relies on.
+static void copy_words(uint8_t* d, const uint8_t* s, size_t n) {
+    word_t head = *(const word_t*)s;
+    word_t tail = *(const word_t*)(s + n - 8);
+    for (size_t i = 8; i < n - 8; i += 8) {
+        *(word_t*)(d + i) = *(const word_t*)(s + i);
+    }
+    *(word_t*)d = head;
+    *(word_t*)(d + n - 8) = tail;
+}
+
+// Unaligned loads, 16-byte aligned stores
+__attribute__((target("sse2")))
+static void copy_sse2(uint8_t* d, const uint8_t* s, size_t n) {
+    v2i64 head, tail;
+    __builtin_memcpy(&head, s, 16);
+    __builtin_memcpy(&tail, s + n - 16, 16);
+
+    size_t i = 16 - ((uintptr_t)d & 15);
+    for (; i + 32 <= n - 16; i += 32) {
+        v2i64 a, b;
+        __builtin_memcpy(&a, s + i, 16);
+        __builtin_memcpy(&b, s + i + 16, 16);
+        *(v2i64*)(d + i) = a;
+        *(v2i64*)(d + i + 16) = b;
+    }
+    for (; i < n - 16; i += 16) {
+        v2i64 a;
+        __builtin_memcpy(&a, s + i, 16);
+        *(v2i64*)(d + i) = a;
+    }
+    __builtin_memcpy(d, &head, 16);
+    __builtin_memcpy(d + n - 16, &tail, 16);
+}
+
+static void fill_words(uint8_t* d, word_t w, size_t n) {
+    for (size_t i = 0; i < n - 8; i += 8) {
+        *(word_t*)(d + i) = w;
+    }
+    *(word_t*)(d + n - 8) = w;
+}
+
+__attribute__((target("sse2")))
+static void fill_sse2(uint8_t* d, word_t w, size_t n) {
+    v2i64 v = { (long long)w, (long long)w };
+    __builtin_memcpy(d, &v, 16);
+    size_t i = 16 - ((uintptr_t)d & 15);
+    for (; i + 32 <= n; i += 32) {
+        *(v2i64*)(d + i) = v;
+        *(v2i64*)(d + i + 16) = v;
+    }
+    for (; i + 16 <= n; i += 16) {
+        *(v2i64*)(d + i) = v;
+    }
+    __builtin_memcpy(d + n - 16, &v, 16);
+}
+
+// Copy from the end down, for memmove() with dest above src
+static void copy_words_backward(uint8_t* d, const uint8_t* s, size_t n) {
+    word_t head = *(const word_t*)s;
+    size_t i = n;
+    while (i > 8) {
+        i -= 8;
+        *(word_t*)(d + i) = *(const word_t*)(s + i);
+    }
+    *(word_t*)d = head;
+}
+
+// Unaligned loads, 16-byte aligned stores, from the end down. The first and
+// last vectors are read up front and stored after the loop.
+__attribute__((target("sse2")))
+static void copy_sse2_backward(uint8_t* d, const uint8_t* s, size_t n) {
+    v2i64 head, tail;
+    __builtin_memcpy(&head, s, 16);
+    __builtin_memcpy(&tail, s + n - 16, 16);
+
+    size_t i = ((uintptr_t)(d + n) & ~(uintptr_t)15) - (uintptr_t)d;
+    for (; i >= 48; i -= 32) {
+        v2i64 a, b;
+        __builtin_memcpy(&a, s + i - 16, 16);
+        __builtin_memcpy(&b, s + i - 32, 16);
+        *(v2i64*)(d + i - 16) = a;
+        *(v2i64*)(d + i - 32) = b;
+    }
+    for (; i > 16; i -= 16) {
+        v2i64 a;
+        __builtin_memcpy(&a, s + i - 16, 16);
+        *(v2i64*)(d + i - 16) = a;
+    }
+    __builtin_memcpy(d, &head, 16);
+    __builtin_memcpy(d + n - 16, &tail, 16);
+}
+
+void* memset(void* ptr, int value, size_t num) {
+    uint8_t* d = ptr;
+    word_t w = (uint8_t)value * ONES;
+    if (num <= 16) {
+        fill_small(d, w, num);
+    } else if (num >= rep_min) {
+        fill_rep(d, (uint8_t)value, num);
+    } else if (num >= STRING_SSE2_MIN && use_sse2) {
+        fill_sse2(d, w, num);
+    } else {
+        fill_words(d, w, num);
+    }
+    return ptr;
+}
+
+void* memcpy(void* dest, const void* src, size_t num) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+    if (num <= 16) {
+        copy_small(d, s, num);
+    } else if (num >= rep_min) {
+        copy_rep(d, s, num);
+    } else if (num >= STRING_SSE2_MIN && use_sse2) {
+        copy_sse2(d, s, num);
+    } else {
+        copy_words(d, s, num);
+    }
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t num) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+    // Forward is right unless dest starts inside src; rep movsb is
+    // architecturally byte-by-byte, so it is safe in that direction as well
+    if ((uintptr_t)d - (uintptr_t)s >= num) return memcpy(dest, src, num);
+    if (num <= 16) {
+        copy_small(d, s, num);
+    } else if (num >= STRING_SSE2_MIN && use_sse2) {
+        copy_sse2_backward(d, s, num);
+    } else {
+        copy_words_backward(d, s, num);
+    }
+    return dest;
+}
+
+// Aligned words never cross a page boundary, so reading past the terminator
+// cannot fault
+int strlen(const char* str) {
+    const char* p = str;
+    while ((uintptr_t)p & (sizeof(word_t) - 1)) {
+        if (!*p) return p - str;
+        p++;
+    }
+    while (!has_zero(*(const word_t*)p)) p += sizeof(word_t);
+    while (*p) p++;
+    return p - str;
+}
+
+// Whole words while they are equal and hold no terminator, otherwise one
+// byte. The two strings are rarely aligned alike, so the word reads are
+// unaligned and only taken where they stay on the page.
+int strcmp(const char* s1, const char* s2) {
+    for (;;) {
+        if (word_in_page(s1) && word_in_page(s2)) {
+            word_t a = *(const word_t*)s1;
+            if (a == *(const word_t*)s2 && !has_zero(a)) {
+                s1 += sizeof(word_t);
+                s2 += sizeof(word_t);
+                continue;
+            }
+        }
+        unsigned char c1 = *s1, c2 = *s2;
+        if (c1 != c2 || !c1) return c1 - c2;
+        s1++;
+        s2++;
+    }
+}
+
+int strncmp(const char* s1, const char* s2, int n) {
+    while(n > 0 && *s1 && (*s1 == *s2)) {
+        s1++; s2++; n--;
+    }
+    if (n == 0) return 0;
+    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+}
+
+// A word is stored only when all of it is string, so nothing past the
+// terminator is written
+void strcpy(char* dest, const char* src) {
+    for (;;) {
+        if (word_in_page(src)) {
+            word_t w = *(const word_t*)src;
+            if (!has_zero(w)) {
+                *(word_t*)dest = w;
+                dest += sizeof(word_t);
+                src += sizeof(word_t);
+                continue;
+            }
+        }
+        if (!(*dest++ = *src++)) return;
+    }
+}
+
+void strncpy(char* dest, const char* src, int n) {
+    int i;
+    for (i = 0; i < n && src[i] != '\0'; i++) {
+        dest[i] = src[i];
+    }
+    for (; i < n; i++) {
+        dest[i] = '\0';
+    }
+}
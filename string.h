@@ -0,0 +1,34 @@
+#ifndef STRING_H
+#define STRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Memory and string routines for the whole kernel; the compiler also calls
+// memcpy/memset for struct copies. Large copies and fills use rep movsb/stosb
+// when the CPU has ERMS and SSE2 otherwise, small ones and the string
+// functions go a machine word at a time.
+//
+// The SSE2 paths do not preserve XMM state, so interrupt handlers must keep
+// their copies and fills below STRING_SSE2_MIN bytes.
+#define STRING_SSE2_MIN 64
+
+// Pick the copy and fill strategy from the CPU features; call after
+// cpu_init(). Until then everything goes a word at a time.
+void string_init();
+
+// Which strategy large copies use, for diagnostics
+const char* string_copy_method();
+
+void* memset(void* ptr, int value, size_t num);
+void* memcpy(void* dest, const void* src, size_t num);
+void* memmove(void* dest, const void* src, size_t num);
+
+int strlen(const char* str);
+int strcmp(const char* s1, const char* s2);
+int strncmp(const char* s1, const char* s2, int n);
+void strcpy(char* dest, const char* src);
+void strncpy(char* dest, const char* src, int n);
+
+#endif
@@ -0,0 +1,95 @@
+#include "timer.h"
+#include "io.h"
+#include "idt.h"
+#include "pic.h"
+
+#define PIT_FREQUENCY 1193182
+#define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND 0x43
+#define PIT_GATE_PORT 0x61
+
+#define CALIBRATION_MS 10
+
+static uint64_t tsc_hz = 0;
+
+// IRQ0 ticks since timer_start_ticks(), one per millisecond
+static volatile uint64_t ticks = 0;
+static void (*tick_handler)() = NULL;
+
+// Count TSC cycles while PIT channel 2 counts down CALIBRATION_MS in one-shot mode
+static uint64_t calibrate_tsc() {
+    uint16_t latch = PIT_FREQUENCY / (1000 / CALIBRATION_MS);
+
+    // Gate channel 2 on, keep the speaker disconnected
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+
+    // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, latch & 0xFF);
+    outb(PIT_CHANNEL2, latch >> 8);
+
+    uint64_t start = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & 0x20)); // OUT2 goes high at terminal count
+    uint64_t end = rdtsc();
+
+    return (end - start) * (1000 / CALIBRATION_MS);
+}
+
+void timer_init() {
+    // Take the fastest of a few runs; a slow one just means we were held up
+    uint64_t best = 0;
+    for (int i = 0; i < 3; i++) {
+        uint64_t hz = calibrate_tsc();
+        if (best == 0 || hz < best) best = hz;
+    }
+    tsc_hz = best;
+}
+
+uint64_t timer_tsc_hz() {
+    return tsc_hz;
+}
+
+uint64_t timer_cycles_to_us(uint64_t cycles) {
+    if (tsc_hz < 1000000) return 0;
+    return cycles / (tsc_hz / 1000000);
+}
+
+// For short intervals only: cycles * 1000 must not overflow
+uint64_t timer_cycles_to_ns(uint64_t cycles) {
+    if (tsc_hz < 1000000) return 0;
+    return cycles * 1000 / (tsc_hz / 1000000);
+}
+
+__attribute__((interrupt))
+static void timer_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    ticks++;
+    if (tick_handler) tick_handler();
+    pic_eoi(IRQ_TIMER);
+}
+
+// Run PIT channel 0 as a TIMER_TICK_HZ rate generator on IRQ0. The caller
+// enables interrupts once every handler is in place.
+void timer_start_ticks() {
+    uint16_t divisor = PIT_FREQUENCY / TIMER_TICK_HZ;
+
+    idt_set_handler(PIC_IRQ_BASE + IRQ_TIMER, (void*)timer_irq);
+
+    // Channel 0, lobyte/hibyte, mode 2 (rate generator)
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, divisor >> 8);
+
+    pic_unmask(IRQ_TIMER);
+}
+
+// Run `handler` in interrupt context on every tick. It must be short and
+// must not touch SSE state.
+void timer_set_tick_handler(void (*handler)()) {
+    tick_handler = handler;
+}
+
+uint64_t timer_ms() {
+    return ticks * 1000 / TIMER_TICK_HZ;
+}
@@ -0,0 +1,24 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Rate of the PIT interrupt that drives timer_ms() and frame pacing
+#define TIMER_TICK_HZ 1000
+
+void timer_init();
+void timer_start_ticks();
+void timer_set_tick_handler(void (*handler)());
+uint64_t timer_ms();
+uint64_t timer_tsc_hz();
+uint64_t timer_cycles_to_us(uint64_t cycles);
+uint64_t timer_cycles_to_ns(uint64_t cycles);
+
+#endif
@@ -0,0 +1,249 @@
+// Host tool: convert an AquaOS serial trace capture into Chrome trace-event
+// JSON (load it in chrome://tracing or https://ui.perfetto.dev).
+//
+//   qemu-system-x86_64 ... -serial file:trace.bin
+//   cc -O2 -o trace2json tools/trace2json.c
+//   ./trace2json trace.bin trace.json
+//
+// The record layout is described in trace.h. Bytes that do not form a valid
+// record (boot messages, a capture that starts mid-record) are skipped.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_SYNC 0xA5
+#define TRACE_HEADER_SIZE 11
+
+enum {
+    TRACE_INFO = 1,
+    TRACE_FRAME_BEGIN,
+    TRACE_FRAME_END,
+    TRACE_KEY,
+    TRACE_MOUSE,
+    TRACE_MALLOC,
+    TRACE_FREE,
+    TRACE_VFS,
+    TRACE_DROPPED,
+    TRACE_TYPE_LIMIT
+};
+
+// Expected payload size per type; -1 means variable (up to 32 bytes)
+static const int payload_sizes[TRACE_TYPE_LIMIT] = {
+    0, 8, 4, 4, 1, 5, 12, 8, -1, 4
+};
+
+static const char* vfs_ops[] = { "mkdir", "create", "read", "write", "remove" };
+
+// Thread ids used to lay the timeline out in rows
+enum { TID_FRAMES = 1, TID_INPUT, TID_HEAP, TID_VFS };
+
+// Live allocations, so frees can be subtracted from the heap counter
+#define ALLOC_SLOTS (1 << 20)
+static uint64_t alloc_ptr[ALLOC_SLOTS];
+static uint32_t alloc_size[ALLOC_SLOTS];
+
+static FILE* out;
+static int first_event = 1;
+static double tsc_per_us = 1000.0; // assume 1 GHz until TRACE_INFO says otherwise
+static uint64_t tsc_origin = 0;
+static int have_origin = 0;
+
+static uint64_t get_le(const uint8_t* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static double to_us(uint64_t tsc) {
+    if (!have_origin) {
+        tsc_origin = tsc;
+        have_origin = 1;
+    }
+    return (double)(tsc - tsc_origin) / tsc_per_us;
+}
+
+static void begin_event() {
+    fputs(first_event ? "\n  " : ",\n  ", out);
+    first_event = 0;
+}
+
+static void put_json_string(const char* s, int len) {
+    fputc('"', out);
+    for (int i = 0; i < len && s[i]; i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7F) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void instant(double ts, int tid, const char* name, int name_len) {
+    begin_event();
+    fputs("{\"name\":", out);
+    put_json_string(name, name_len);
+    fprintf(out, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, tid);
+}
+
+static void thread_name(int tid, const char* name) {
+    begin_event();
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            tid, name);
+}
+
+static size_t alloc_slot(uint64_t ptr) {
+    size_t i = (size_t)((ptr >> 4) * 0x9E3779B97F4A7C15ull) & (ALLOC_SLOTS - 1);
+    while (alloc_ptr[i] && alloc_ptr[i] != ptr) i = (i + 1) & (ALLOC_SLOTS - 1);
+    return i;
+}
+
+// Removal from a linear-probe table: re-insert the rest of the cluster
+static void alloc_remove(size_t i) {
+    alloc_ptr[i] = 0;
+    for (size_t j = (i + 1) & (ALLOC_SLOTS - 1); alloc_ptr[j]; j = (j + 1) & (ALLOC_SLOTS - 1)) {
+        uint64_t p = alloc_ptr[j];
+        uint32_t sz = alloc_size[j];
+        alloc_ptr[j] = 0;
+        size_t k = alloc_slot(p);
+        alloc_ptr[k] = p;
+        alloc_size[k] = sz;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s capture.bin [trace.json]\n", argv[0]);
+        return 2;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    if (!data || fread(data, 1, size, in) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+    thread_name(TID_FRAMES, "frames");
+    thread_name(TID_INPUT, "input");
+    thread_name(TID_HEAP, "heap");
+    thread_name(TID_VFS, "vfs");
+
+    uint64_t frame_begin_tsc = 0;
+    uint32_t frame_begin_number = 0;
+    int frame_open = 0;
+    int64_t heap_bytes = 0;
+    long records = 0, skipped = 0;
+
+    long pos = 0;
+    while (pos + TRACE_HEADER_SIZE <= size) {
+        const uint8_t* r = data + pos;
+        int type = r[1], len = r[2];
+        int expected = (type > 0 && type < TRACE_TYPE_LIMIT) ? payload_sizes[type] : -2;
+        int valid = r[0] == TRACE_SYNC && expected != -2 &&
+                    (expected == -1 ? (len >= 1 && len <= 32) : len == expected) &&
+                    pos + TRACE_HEADER_SIZE + len <= size;
+        if (!valid) {
+            pos++;
+            skipped++;
+            continue;
+        }
+
+        uint64_t tsc = get_le(r + 3, 8);
+        const uint8_t* p = r + TRACE_HEADER_SIZE;
+        char name[64];
+        records++;
+
+        switch (type) {
+            case TRACE_INFO: {
+                uint64_t hz = get_le(p, 8);
+                if (hz >= 1000000) tsc_per_us = hz / 1e6;
+                to_us(tsc);
+                break;
+            }
+            case TRACE_FRAME_BEGIN:
+                frame_begin_tsc = tsc;
+                frame_begin_number = (uint32_t)get_le(p, 4);
+                frame_open = 1;
+                break;
+            case TRACE_FRAME_END: {
+                uint32_t frame = (uint32_t)get_le(p, 4);
+                if (frame_open && frame == frame_begin_number) {
+                    double start = to_us(frame_begin_tsc);
+                    begin_event();
+                    fprintf(out, "{\"name\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                                 "\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%u}}",
+                            start, to_us(tsc) - start, TID_FRAMES, frame);
+                }
+                frame_open = 0;
+                break;
+            }
+            case TRACE_KEY: {
+                int n = snprintf(name, sizeof(name), "key %c", p[0] >= 32 && p[0] < 127 ? p[0] : '?');
+                instant(to_us(tsc), TID_INPUT, name, n);
+                break;
+            }
+            case TRACE_MOUSE: {
+                int x = (int16_t)get_le(p, 2), y = (int16_t)get_le(p + 2, 2);
+                begin_event();
+                fprintf(out, "{\"name\":\"mouse\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+                             "\"args\":{\"x\":%d,\"y\":%d,\"buttons\":%u}}",
+                        to_us(tsc), TID_INPUT, x, y, p[4]);
+                break;
+            }
+            case TRACE_MALLOC:
+            case TRACE_FREE: {
+                uint64_t ptr = get_le(p, 8);
+                size_t slot = alloc_slot(ptr);
+                if (type == TRACE_MALLOC) {
+                    uint32_t bytes = (uint32_t)get_le(p + 8, 4);
+                    if (alloc_ptr[slot]) heap_bytes -= alloc_size[slot];
+                    alloc_ptr[slot] = ptr;
+                    alloc_size[slot] = bytes;
+                    heap_bytes += bytes;
+                } else if (alloc_ptr[slot]) {
+                    heap_bytes -= alloc_size[slot];
+                    alloc_remove(slot);
+                }
+                begin_event();
+                fprintf(out, "{\"name\":\"heap\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+                             "\"args\":{\"bytes\":%lld}}",
+                        to_us(tsc), TID_HEAP, (long long)heap_bytes);
+                break;
+            }
+            case TRACE_VFS: {
+                const char* op = p[0] < sizeof(vfs_ops) / sizeof(vfs_ops[0]) ? vfs_ops[p[0]] : "op?";
+                int n = snprintf(name, sizeof(name), "%s %.*s", op, len - 1, (const char*)p + 1);
+                instant(to_us(tsc), TID_VFS, name, n);
+                break;
+            }
+            case TRACE_DROPPED: {
+                int n = snprintf(name, sizeof(name), "%u records dropped", (uint32_t)get_le(p, 4));
+                instant(to_us(tsc), TID_FRAMES, name, n);
+                break;
+            }
+        }
+        pos += TRACE_HEADER_SIZE + len;
+    }
+
+    fputs("\n]}\n", out);
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "%ld records, %ld bytes skipped\n", records, skipped);
+    free(data);
+    return 0;
+}
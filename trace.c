@@ -0,0 +1,129 @@
+#include "trace.h"
+#include "serial.h"
+#include "timer.h"
+
+#define TRACE_HEADER_SIZE 11
+#define TRACE_MAX_PAYLOAD 32
+
+static bool enabled = false;
+static uint32_t dropped = 0;        // since the last TRACE_DROPPED got out
+static uint32_t dropped_total = 0;
+
+static uint8_t* put_u8(uint8_t* p, uint8_t v) {
+    *p++ = v;
+    return p;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t v) {
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+    return p;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) *p++ = (v >> (8 * i)) & 0xFF;
+    return p;
+}
+
+static uint8_t* put_u64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) *p++ = (v >> (8 * i)) & 0xFF;
+    return p;
+}
+
+static bool emit_raw(trace_type_t type, const uint8_t* payload, int len) {
+    uint8_t record[TRACE_HEADER_SIZE + TRACE_MAX_PAYLOAD];
+    uint8_t* p = record;
+    p = put_u8(p, TRACE_SYNC);
+    p = put_u8(p, type);
+    p = put_u8(p, len);
+    p = put_u64(p, rdtsc());
+    for (int i = 0; i < len; i++) *p++ = payload[i];
+    return serial_write(record, p - record);
+}
+
+// Records are all-or-nothing in the ring, so a full ring loses whole records
+// and the stream stays parseable. Losses are reported as soon as there is room.
+static void emit(trace_type_t type, const uint8_t* payload, int len) {
+    if (!enabled) return;
+    if (dropped) {
+        uint8_t count[4];
+        put_u32(count, dropped);
+        if (!emit_raw(TRACE_DROPPED, count, sizeof(count))) {
+            dropped++;
+            dropped_total++;
+            return;
+        }
+        dropped = 0;
+    }
+    if (!emit_raw(type, payload, len)) {
+        dropped++;
+        dropped_total++;
+    }
+}
+
+bool trace_init() {
+    enabled = serial_present();
+    if (enabled) {
+        uint8_t payload[8];
+        put_u64(payload, timer_tsc_hz());
+        emit(TRACE_INFO, payload, sizeof(payload));
+    }
+    return enabled;
+}
+
+bool trace_enabled() {
+    return enabled;
+}
+
+uint32_t trace_dropped() {
+    return dropped_total;
+}
+
+void trace_frame_begin(uint32_t frame) {
+    uint8_t payload[4];
+    put_u32(payload, frame);
+    emit(TRACE_FRAME_BEGIN, payload, sizeof(payload));
+}
+
+void trace_frame_end(uint32_t frame) {
+    uint8_t payload[4];
+    put_u32(payload, frame);
+    emit(TRACE_FRAME_END, payload, sizeof(payload));
+}
+
+void trace_key(char c) {
+    uint8_t payload[1] = { (uint8_t)c };
+    emit(TRACE_KEY, payload, sizeof(payload));
+}
+
+void trace_mouse(int x, int y, uint8_t buttons) {
+    uint8_t payload[5];
+    uint8_t* p = put_u16(payload, (uint16_t)x);
+    p = put_u16(p, (uint16_t)y);
+    put_u8(p, buttons);
+    emit(TRACE_MOUSE, payload, sizeof(payload));
+}
+
+void trace_malloc(void* ptr, size_t size) {
+    uint8_t payload[12];
+    uint8_t* p = put_u64(payload, (uint64_t)ptr);
+    put_u32(p, (uint32_t)size);
+    emit(TRACE_MALLOC, payload, sizeof(payload));
+}
+
+void trace_free(void* ptr) {
+    uint8_t payload[8];
+    put_u64(payload, (uint64_t)ptr);
+    emit(TRACE_FREE, payload, sizeof(payload));
+}
+
+void trace_vfs(trace_vfs_op_t op, const char* name) {
+    uint8_t payload[TRACE_MAX_PAYLOAD];
+    int len = 0;
+    payload[len++] = op;
+    while (name && name[len - 1] && len < TRACE_MAX_PAYLOAD) {
+        payload[len] = name[len - 1];
+        len++;
+    }
+    emit(TRACE_VFS, payload, len);
+}
@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Binary trace stream sent over COM1. Every record is
+//   u8 TRACE_SYNC, u8 type, u8 payload length, u64 TSC, payload
+// little endian. tools/trace2json.c turns a capture into Chrome trace JSON.
+#define TRACE_SYNC 0xA5
+
+typedef enum {
+    TRACE_INFO = 1,        // u64 TSC frequency in Hz; sent first
+    TRACE_FRAME_BEGIN,     // u32 frame number
+    TRACE_FRAME_END,       // u32 frame number
+    TRACE_KEY,             // u8 character
+    TRACE_MOUSE,           // i16 x, i16 y, u8 buttons
+    TRACE_MALLOC,          // u64 address, u32 size
+    TRACE_FREE,            // u64 address
+    TRACE_VFS,             // u8 operation, name (up to 31 bytes, not terminated)
+    TRACE_DROPPED          // u32 records lost since the last one that got through
+} trace_type_t;
+
+typedef enum {
+    TRACE_VFS_MKDIR,
+    TRACE_VFS_CREATE,
+    TRACE_VFS_READ,
+    TRACE_VFS_WRITE,
+    TRACE_VFS_REMOVE
+} trace_vfs_op_t;
+
+// Start tracing if COM1 exists; records are dropped (and counted) until then
+// and whenever the transmit ring is full
+bool trace_init();
+bool trace_enabled();
+uint32_t trace_dropped();
+
+void trace_frame_begin(uint32_t frame);
+void trace_frame_end(uint32_t frame);
+void trace_key(char c);
+void trace_mouse(int x, int y, uint8_t buttons);
+void trace_malloc(void* ptr, size_t size);
+void trace_free(void* ptr);
+void trace_vfs(trace_vfs_op_t op, const char* name);
+
+#endif
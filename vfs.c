@@ -1,11 +1,9 @@
 #include "vfs.h"
 #include "memory.h"
 #include "graphics.h" // For null check debugging if needed
-#include "shell.h" // For string helpers
-
-// Re-declare string helpers if not in a shared header (doing here for now)
-int strcmp(const char* s1, const char* s2); // External from shell.c/lib
-void strcpy(char* dest, const char* src);
+#include "shell.h"
+#include "string.h"
+#include "trace.h"
 
 static fs_node_t* root_node = NULL;
 
@@ -38,6 +36,7 @@ fs_node_t* vfs_create_node(char* name, int flags) {
 
 int vfs_write(fs_node_t* file, char* data) {
     if (!file || file->flags != FS_FILE) return -1;
+    trace_vfs(TRACE_VFS_WRITE, file->name);
     
     // Free old content if exists
     if (file->content) {
@@ -63,11 +62,13 @@ int vfs_write(fs_node_t* file, char* data) {
 
 char* vfs_read(fs_node_t* file) {
     if (!file || file->flags != FS_FILE) return NULL;
+    trace_vfs(TRACE_VFS_READ, file->name);
     return file->content;
 }
 
 int vfs_remove(fs_node_t* parent, char* name) {
     if (!parent) return -1;
+    trace_vfs(TRACE_VFS_REMOVE, name);
     
     fs_node_t* prev = NULL;
     fs_node_t* curr = parent->first_child;
@@ -98,6 +99,7 @@ int vfs_remove(fs_node_t* parent, char* name) {
 
 fs_node_t* vfs_mkdir(fs_node_t* parent, char* name) {
     if (!parent) return NULL;
+    trace_vfs(TRACE_VFS_MKDIR, name);
     fs_node_t* node = vfs_create_node(name, FS_DIRECTORY);
     node->parent = parent;
     
@@ -114,6 +116,7 @@ fs_node_t* vfs_mkdir(fs_node_t* parent, char* name) {
 
 fs_node_t* vfs_creat(fs_node_t* parent, char* name) {
     if (!parent) return NULL;
+    trace_vfs(TRACE_VFS_CREATE, name);
     fs_node_t* node = vfs_create_node(name, FS_FILE);
     node->parent = parent;
 
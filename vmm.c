@@ -0,0 +1,410 @@
+#include "vmm.h"
+#include "cpu.h"
+#include "pmm.h"
+
+#define MSR_EFER 0xC0000080
+#define EFER_NXE (1ull << 11)
+
+#define HUGE_PAGE_SIZE (1024ull * 1024 * 1024)
+
+#define PTE_PRESENT (1ull << 0)
+#define PTE_WRITABLE (1ull << 1)
+#define PTE_USER (1ull << 2)
+#define PTE_PWT (1ull << 3)
+#define PTE_PCD (1ull << 4)
+#define PTE_HUGE (1ull << 7)          // PS bit in PDPT/PD entries
+#define PTE_PAT_4K (1ull << 7)        // PAT bit in a PT entry
+#define PTE_GLOBAL (1ull << 8)
+#define PTE_PAT_LARGE (1ull << 12)    // PAT bit in a 2M/1G entry
+#define PTE_NX (1ull << 63)
+#define PTE_ADDR_MASK 0x000FFFFFFFFFF000ull
+#define PTE_LARGE_ADDR_MASK 0x000FFFFFFFFFE000ull
+
+// Free address space in the window, sorted by base and never adjacent
+#define VMM_MAX_RANGES 256
+
+typedef struct {
+    uint64_t base;
+    uint64_t size;
+} va_range_t;
+
+static va_range_t ranges[VMM_MAX_RANGES];
+static int range_count = 0;
+
+static uint64_t hhdm = 0;
+static uint64_t* pml4 = NULL;
+static bool nx_enabled = false;
+
+static inline uint64_t page_round_up(uint64_t v) {
+    return (v + VMM_PAGE_SIZE - 1) & ~(uint64_t)(VMM_PAGE_SIZE - 1);
+}
+
+static inline void invlpg(uint64_t va) {
+    asm volatile ("invlpg (%0)" : : "r"(va) : "memory");
+}
+
+static uint64_t* table_virt(uint64_t entry) {
+    return (uint64_t*)((entry & PTE_ADDR_MASK) + hhdm);
+}
+
+// Page tables are single zeroed pages from the PMM
+static uint64_t* alloc_table(uint64_t* phys) {
+    if (!pmm_alloc(0, phys)) return NULL;
+    uint64_t* table = (uint64_t*)pmm_to_virt(*phys);
+    for (int i = 0; i < 512; i++) table[i] = 0;
+    return table;
+}
+
+// Cache type selection, by the PAT layout pat_init() programs: entry 0 is WB,
+// entry 3 (PCD|PWT) is UC, entry 5 (PAT|PWT) is WC
+static uint64_t leaf_bits(uint32_t flags, bool large) {
+    uint64_t e = PTE_PRESENT;
+    if (flags & VMM_WRITE) e |= PTE_WRITABLE;
+    if ((flags & VMM_NX) && nx_enabled) e |= PTE_NX;
+    switch (flags & VMM_CACHE_MASK) {
+    case VMM_WC:
+        e |= PTE_PWT | (large ? PTE_PAT_LARGE : PTE_PAT_4K);
+        break;
+    case VMM_UC:
+        e |= PTE_PCD | PTE_PWT;
+        break;
+    }
+    if (large) e |= PTE_HUGE;
+    return e;
+}
+
+// Table an intermediate entry points to, creating an empty one if there is
+// none. NULL if the entry is a large page or no page was left.
+static uint64_t* next_level(uint64_t* entry) {
+    if (*entry & PTE_PRESENT) {
+        return (*entry & PTE_HUGE) ? NULL : table_virt(*entry);
+    }
+    uint64_t phys;
+    uint64_t* table = alloc_table(&phys);
+    if (!table) return NULL;
+    // Leaves decide about write and NX; the upper levels allow everything
+    *entry = phys | PTE_PRESENT | PTE_WRITABLE;
+    return table;
+}
+
+// Replace a 1G or 2M mapping with a table of 512 next-smaller mappings carrying the
+// same attributes, so only part of the original range can be changed
+static bool split_large(uint64_t* entry, bool to_4k) {
+    uint64_t old = *entry;
+    uint64_t table_phys;
+    uint64_t* table = alloc_table(&table_phys);
+    if (!table) return false;
+
+    uint64_t flags = old & (0xFFFull & ~PTE_PAT_LARGE & ~PTE_HUGE);
+    flags |= old & PTE_NX;
+    uint64_t base = old & PTE_LARGE_ADDR_MASK;
+    uint64_t step = to_4k ? VMM_PAGE_SIZE : VMM_LARGE_PAGE_SIZE;
+
+    for (int i = 0; i < 512; i++) {
+        uint64_t e = (base + i * step) | flags;
+        if (to_4k) {
+            if (old & PTE_PAT_LARGE) e |= PTE_PAT_4K;
+        } else {
+            e |= PTE_HUGE | (old & PTE_PAT_LARGE);
+        }
+        table[i] = e;
+    }
+
+    *entry = table_phys | PTE_PRESENT | PTE_WRITABLE | (old & PTE_USER);
+    return true;
+}
+
+// Find the leaf entry mapping va. A large page that [start, end) only partly
+// covers is split so the caller can change just its part. *span is the size
+// the entry maps, or of the hole when *leaf comes back NULL. False if a split
+// ran out of pages.
+static bool find_leaf(uint64_t va, uint64_t start, uint64_t end, uint64_t** leaf, uint64_t* span) {
+    uint64_t* entry = &pml4[(va >> 39) & 511];
+    *leaf = NULL;
+    *span = 1ull << 39;
+    if (!(*entry & PTE_PRESENT)) return true;
+
+    for (int shift = 30; shift >= 12; shift -= 9) {
+        entry = &table_virt(*entry)[(va >> shift) & 511];
+        *span = 1ull << shift;
+        if (!(*entry & PTE_PRESENT)) return true;
+        if (shift == 12) break;
+        if (*entry & PTE_HUGE) {
+            uint64_t page = va & ~(*span - 1);
+            if (page >= start && page + *span <= end) break;
+            if (!split_large(entry, shift == 21)) return false;
+        }
+    }
+    *leaf = entry;
+    return true;
+}
+
+// NX is only honoured with EFER.NXE set; without it bit 63 is reserved and
+// would fault
+static void enable_nx() {
+    uint32_t a, b, c, d;
+    cpuid(0x80000000, 0, &a, &b, &c, &d);
+    if (a < 0x80000001) return;
+    cpuid(0x80000001, 0, &a, &b, &c, &d);
+    if (!(d & (1 << 20))) return;
+
+    uint64_t efer = rdmsr(MSR_EFER);
+    if (!(efer & EFER_NXE)) wrmsr(MSR_EFER, efer | EFER_NXE);
+    nx_enabled = true;
+}
+
+bool vmm_init(uint64_t hhdm_offset) {
+    hhdm = hhdm_offset;
+
+    uint64_t cr3;
+    asm volatile ("mov %%cr3, %0" : "=r"(cr3));
+    pml4 = table_virt(cr3);
+
+    // The window must be ours alone
+    if (pml4[(VMM_WINDOW_BASE >> 39) & 511] & PTE_PRESENT) return false;
+
+    enable_nx();
+
+    ranges[0].base = VMM_WINDOW_BASE;
+    ranges[0].size = VMM_WINDOW_SIZE;
+    range_count = 1;
+    return true;
+}
+
+void* vmm_alloc_va(size_t size, size_t align) {
+    size = page_round_up(size);
+    if (size == 0) return NULL;
+    if (align < VMM_PAGE_SIZE) align = VMM_PAGE_SIZE;
+
+    // First fit. Carving from the middle of a range leaves a piece on each
+    // side, which takes one more slot.
+    for (int i = 0; i < range_count; i++) {
+        va_range_t* r = &ranges[i];
+        uint64_t start = (r->base + align - 1) & ~(uint64_t)(align - 1);
+        uint64_t end = r->base + r->size;
+        if (start < r->base || start + size > end) continue;
+
+        bool front = start > r->base;
+        bool back = start + size < end;
+        if (front && back) {
+            if (range_count == VMM_MAX_RANGES) continue;
+            for (int j = range_count; j > i + 1; j--) ranges[j] = ranges[j - 1];
+            range_count++;
+            ranges[i + 1].base = start + size;
+            ranges[i + 1].size = end - (start + size);
+            r->size = start - r->base;
+        } else if (front) {
+            r->size = start - r->base;
+        } else if (back) {
+            r->base = start + size;
+            r->size = end - r->base;
+        } else {
+            for (int j = i; j < range_count - 1; j++) ranges[j] = ranges[j + 1];
+            range_count--;
+        }
+        return (void*)start;
+    }
+    return NULL;
+}
+
+void vmm_free_va(void* virt, size_t size) {
+    uint64_t base = (uintptr_t)virt;
+    size = page_round_up(size);
+    if (size == 0) return;
+
+    int i = 0;
+    while (i < range_count && ranges[i].base < base) i++;
+
+    bool merge_prev = i > 0 && ranges[i - 1].base + ranges[i - 1].size == base;
+    bool merge_next = i < range_count && base + size == ranges[i].base;
+    if (merge_prev && merge_next) {
+        ranges[i - 1].size += size + ranges[i].size;
+        for (int j = i; j < range_count - 1; j++) ranges[j] = ranges[j + 1];
+        range_count--;
+    } else if (merge_prev) {
+        ranges[i - 1].size += size;
+    } else if (merge_next) {
+        ranges[i].base = base;
+        ranges[i].size += size;
+    } else if (range_count < VMM_MAX_RANGES) {
+        for (int j = range_count; j > i; j--) ranges[j] = ranges[j - 1];
+        range_count++;
+        ranges[i].base = base;
+        ranges[i].size = size;
+    }
+    // With every slot taken the range is lost; the window is large enough
+    // that this only costs address space
+}
+
+bool vmm_map(void* virt, uint64_t phys, size_t size, uint32_t flags) {
+    uint64_t start = (uintptr_t)virt;
+    uint64_t end = start + page_round_up(size);
+    uint64_t va = start;
+
+    while (va < end) {
+        uint64_t* pdpt = next_level(&pml4[(va >> 39) & 511]);
+        uint64_t* pd = pdpt ? next_level(&pdpt[(va >> 30) & 511]) : NULL;
+        if (!pd) break;
+        uint64_t* pde = &pd[(va >> 21) & 511];
+
+        if (!((va | phys) & (VMM_LARGE_PAGE_SIZE - 1)) && end - va >= VMM_LARGE_PAGE_SIZE) {
+            if (*pde & PTE_PRESENT) {
+                if (*pde & PTE_HUGE) break; // already mapped
+                // A table left behind by earlier 4K mappings; it must be empty
+                uint64_t* pt = table_virt(*pde);
+                int used = 0;
+                for (int i = 0; i < 512; i++) used |= (pt[i] & PTE_PRESENT) != 0;
+                if (used) break;
+                pmm_free(*pde & PTE_ADDR_MASK);
+            }
+            *pde = phys | leaf_bits(flags, true);
+            invlpg(va);
+            va += VMM_LARGE_PAGE_SIZE;
+            phys += VMM_LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        uint64_t* pt = next_level(pde);
+        if (!pt) break;
+        uint64_t* pte = &pt[(va >> 12) & 511];
+        if (*pte & PTE_PRESENT) break;
+        *pte = phys | leaf_bits(flags, false);
+        va += VMM_PAGE_SIZE;
+        phys += VMM_PAGE_SIZE;
+    }
+
+    if (va < end) {
+        // Out of page-table pages, or something was already there
+        vmm_unmap(virt, va - start);
+        return false;
+    }
+    return true;
+}
+
+void vmm_unmap(void* virt, size_t size) {
+    uint64_t start = (uintptr_t)virt & ~(uint64_t)(VMM_PAGE_SIZE - 1);
+    uint64_t end = page_round_up((uintptr_t)virt + size);
+    uint64_t va = start;
+
+    while (va < end) {
+        uint64_t* leaf;
+        uint64_t span;
+        if (!find_leaf(va, start, end, &leaf, &span)) {
+            // Cannot split a large page to unmap part of it; leave it mapped
+            span = VMM_LARGE_PAGE_SIZE;
+        } else if (leaf) {
+            *leaf = 0;
+            invlpg(va);
+        }
+        va = (va & ~(span - 1)) + span;
+    }
+}
+
+bool vmm_protect(void* virt, size_t size, uint32_t flags) {
+    uint64_t start = (uintptr_t)virt & ~(uint64_t)(VMM_PAGE_SIZE - 1);
+    uint64_t end = page_round_up((uintptr_t)virt + size);
+    uint64_t va = start;
+    bool ok = true;
+
+    while (va < end) {
+        uint64_t* leaf;
+        uint64_t span;
+        if (!find_leaf(va, start, end, &leaf, &span) || !leaf) {
+            ok = false;
+            break;
+        }
+        bool large = span > VMM_PAGE_SIZE;
+        uint64_t addr = *leaf & (large ? PTE_LARGE_ADDR_MASK : PTE_ADDR_MASK);
+        *leaf = addr | (*leaf & (PTE_USER | PTE_GLOBAL)) | leaf_bits(flags, large);
+        invlpg(va);
+        va = (va & ~(span - 1)) + span;
+    }
+
+    // Lines cached under the old type must not be written back under the new
+    asm volatile ("wbinvd" ::: "memory");
+    return ok;
+}
+
+uint64_t vmm_translate(const void* virt) {
+    uint64_t va = (uintptr_t)virt;
+    uint64_t* entry = &pml4[(va >> 39) & 511];
+    if (!(*entry & PTE_PRESENT)) return 0;
+
+    for (int shift = 30; shift >= 12; shift -= 9) {
+        entry = &table_virt(*entry)[(va >> shift) & 511];
+        if (!(*entry & PTE_PRESENT)) return 0;
+        if (shift == 12 || (*entry & PTE_HUGE)) {
+            uint64_t page = 1ull << shift;
+            return (*entry & PTE_ADDR_MASK & ~(page - 1)) + (va & (page - 1));
+        }
+    }
+    return 0;
+}
+
+// Window space for `bytes` of mapping starting at a physical (or virtual)
+// page: mappings of 2 MiB or more are placed at the same offset within a
+// 2 MiB page as the memory behind them, so all but the ends map large
+static size_t large_skew(uint64_t page, size_t bytes) {
+    return bytes >= VMM_LARGE_PAGE_SIZE ? (page & (VMM_LARGE_PAGE_SIZE - 1)) : 0;
+}
+
+void* vmm_map_phys(uint64_t phys, size_t size, uint32_t flags) {
+    if (size == 0) return NULL;
+    uint64_t page = phys & ~(uint64_t)(VMM_PAGE_SIZE - 1);
+    size_t bytes = page_round_up(phys + size) - page;
+    size_t skew = large_skew(page, bytes);
+
+    uint8_t* base = (uint8_t*)vmm_alloc_va(bytes + skew,
+                                           bytes >= VMM_LARGE_PAGE_SIZE ? VMM_LARGE_PAGE_SIZE : VMM_PAGE_SIZE);
+    if (!base) return NULL;
+    if (!vmm_map(base + skew, page, bytes, flags)) {
+        vmm_free_va(base, bytes + skew);
+        return NULL;
+    }
+    return base + skew + (phys - page);
+}
+
+void vmm_unmap_phys(void* virt, size_t size) {
+    if (size == 0) return;
+    uint64_t page = (uintptr_t)virt & ~(uint64_t)(VMM_PAGE_SIZE - 1);
+    size_t bytes = page_round_up((uintptr_t)virt + size) - page;
+    size_t skew = large_skew(page, bytes);
+
+    vmm_unmap((void*)page, bytes);
+    vmm_free_va((void*)(page - skew), bytes + skew);
+}
+
+void* vmm_alloc_stack(size_t size) {
+    size = page_round_up(size);
+    int order = pmm_order_for(size);
+    uint64_t phys;
+    if (order < 0 || !pmm_alloc(order, &phys)) return NULL;
+
+    // The guard pages are part of the reservation, so nothing else is ever
+    // mapped next to the stack
+    uint8_t* base = (uint8_t*)vmm_alloc_va(size + 2 * VMM_PAGE_SIZE, VMM_PAGE_SIZE);
+    if (!base) {
+        pmm_free(phys);
+        return NULL;
+    }
+    if (!vmm_map(base + VMM_PAGE_SIZE, phys, size, VMM_DATA)) {
+        vmm_free_va(base, size + 2 * VMM_PAGE_SIZE);
+        pmm_free(phys);
+        return NULL;
+    }
+    return base + VMM_PAGE_SIZE + size;
+}
+
+size_t vmm_va_free() {
+    size_t total = 0;
+    for (int i = 0; i < range_count; i++) total += ranges[i].size;
+    return total;
+}
+
+size_t vmm_va_largest() {
+    size_t largest = 0;
+    for (int i = 0; i < range_count; i++) {
+        if (ranges[i].size > largest) largest = ranges[i].size;
+    }
+    return largest;
+}
@@ -0,0 +1,60 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Kernel virtual memory on top of the 4-level page tables Limine left in CR3.
+// The HHDM and the kernel image stay as the bootloader mapped them; everything
+// the kernel maps itself goes into a window of its own, handed out by a small
+// range allocator. Mappings use 2 MiB pages wherever virtual and physical
+// addresses line up, 4 KiB pages elsewhere.
+#define VMM_PAGE_SIZE 4096
+#define VMM_LARGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define VMM_WINDOW_BASE 0xFFFFC00000000000ull // one PML4 slot, 512 GiB
+#define VMM_WINDOW_SIZE (512ull * 1024 * 1024 * 1024)
+
+// Mapping flags. Pages are read-only, executable and write-back by default.
+#define VMM_WRITE      (1 << 0)
+#define VMM_NX         (1 << 1) // ignored if the CPU has no NX
+#define VMM_WB         (0 << 2)
+#define VMM_WC         (1 << 2) // needs the PAT layout from pat_init()
+#define VMM_UC         (2 << 2)
+#define VMM_CACHE_MASK (3 << 2)
+
+#define VMM_DATA (VMM_WRITE | VMM_NX)
+
+bool vmm_init(uint64_t hhdm_offset);
+
+// Reserve and release address space in the window. Nothing is mapped.
+void* vmm_alloc_va(size_t size, size_t align);
+void vmm_free_va(void* virt, size_t size);
+
+// Map [phys, phys + size) at virt, which must be unmapped; both page aligned
+bool vmm_map(void* virt, uint64_t phys, size_t size, uint32_t flags);
+void vmm_unmap(void* virt, size_t size);
+
+// Replace the flags of an existing mapping, anywhere in the address space;
+// large pages that are only partly covered are split first
+bool vmm_protect(void* virt, size_t size, uint32_t flags);
+
+// Physical address behind virt, or 0 if it is not mapped
+uint64_t vmm_translate(const void* virt);
+
+// Map physical memory (a framebuffer, a heap region) into the window. The
+// virtual address keeps the physical offset within a 2 MiB page, so anything
+// 2 MiB or larger gets large pages.
+void* vmm_map_phys(uint64_t phys, size_t size, uint32_t flags);
+void vmm_unmap_phys(void* virt, size_t size);
+
+// A kernel stack of `size` bytes with an unmapped guard page on each side.
+// Returns the initial stack pointer (the top), or NULL.
+void* vmm_alloc_stack(size_t size);
+
+// Address space left in the window, and its largest free range
+size_t vmm_va_free();
+size_t vmm_va_largest();
+
+#endif
@@ -1,25 +1,370 @@
 #include "window.h"
 #include "graphics.h"
 #include "memory.h"
+#include "string.h"
 #include "shell.h"
+#include "pool.h"
+#include "dock.h"
+#include "nano.h"
+#include "hittest.h"
 
-static window_t* windows[MAX_WINDOWS];
+// Window stack, bottom to top. The registry doubles when it fills up.
+#define WINDOW_REGISTRY_INITIAL 8
+static window_t** windows = NULL;
 static int window_count = 0;
+static int window_capacity = 0;
 static window_t* active_window = NULL;
 
-// External string helpers
-extern int strcmp(const char* s1, const char* s2);
-extern void strcpy(char* dest, const char* src);
+// Window being dragged or resized, so pointer motion goes straight to it
+static window_t* grabbed = NULL;
+
+// Hit-test layers: every raise hands out a higher z, and a window's parts sit
+// above its body in hit_parts[] order (close button on top)
+static int next_z = 1;
+
+#define RESIZE_EDGE_SIZE 8
+#define MIN_WINDOW_WIDTH 200
+#define MIN_WINDOW_HEIGHT 150
+
+// window_t structures come from a pool, so opening and closing windows all day
+// neither walks the heap nor fragments it
+#define WINDOW_POOL_CHUNK 8
+static pool_t window_pool;
+
+// Pixel buffers of closed or resized windows, kept for reuse. Window sizes vary,
+// so buffers are matched by capacity (in pixels) rather than pooled by size.
+#define SURFACE_CACHE_SLOTS 4
+static struct {
+    uint32_t* pixels;
+    size_t capacity;
+} surface_cache[SURFACE_CACHE_SLOTS];
+
+// Desktop area uncovered by windows that moved or shrank since the last frame
+static rect_t exposed;
+static bool has_exposed = false;
+
+// Visible region of each window (same index as windows[]): its frame and shadow
+// minus the frames of the windows above it, as a list of disjoint rectangles.
+// Shadows are blended, so they do not hide what is below them.
+#define MAX_VISIBLE_RECTS 32
+typedef struct {
+    rect_t rects[MAX_VISIBLE_RECTS];
+    int count;
+} region_t;
+
+static region_t* visible = NULL; // one per registry slot
+static bool visibility_dirty = true;
 
 void wm_init() {
     window_count = 0;
     active_window = NULL;
+    grabbed = NULL;
+    has_exposed = false;
+    visibility_dirty = true;
+    pool_init(&window_pool, sizeof(window_t), WINDOW_POOL_CHUNK);
+}
+
+// Double the window stack and the visible regions that go with it
+static bool wm_grow_registry() {
+    int capacity = window_capacity ? window_capacity * 2 : WINDOW_REGISTRY_INITIAL;
+    window_t** new_windows = (window_t**)malloc(capacity * sizeof(window_t*));
+    region_t* new_visible = (region_t*)malloc(capacity * sizeof(region_t));
+    if (!new_windows || !new_visible) {
+        free(new_windows);
+        free(new_visible);
+        return false;
+    }
+
+    for (int i = 0; i < window_count; i++) new_windows[i] = windows[i];
+    free(windows);
+    free(visible);
+    windows = new_windows;
+    visible = new_visible;
+    window_capacity = capacity;
+    visibility_dirty = true;
+    return true;
+}
+
+// Remove `hole` from every rectangle in the region, splitting each into up to
+// four pieces. If the list would overflow the rectangle is kept whole; windows
+// are still painted bottom to top, so that only costs some overdraw.
+static void region_subtract(region_t* region, rect_t hole) {
+    rect_t out[MAX_VISIBLE_RECTS];
+    int n = 0;
+
+    for (int i = 0; i < region->count; i++) {
+        rect_t r = region->rects[i];
+        int r_right = r.x + r.width, r_bottom = r.y + r.height;
+        int h_right = hole.x + hole.width, h_bottom = hole.y + hole.height;
+        if (hole.x >= r_right || h_right <= r.x || hole.y >= r_bottom || h_bottom <= r.y) {
+            out[n++] = r;
+            continue;
+        }
+
+        // Bands above and below the hole, then the parts left and right of it
+        int band_top = hole.y > r.y ? hole.y : r.y;
+        int band_bottom = h_bottom < r_bottom ? h_bottom : r_bottom;
+        rect_t pieces[4];
+        int count = 0;
+        if (hole.y > r.y) {
+            rect_t above = { r.x, r.y, r.width, hole.y - r.y };
+            pieces[count++] = above;
+        }
+        if (h_bottom < r_bottom) {
+            rect_t below = { r.x, h_bottom, r.width, r_bottom - h_bottom };
+            pieces[count++] = below;
+        }
+        if (hole.x > r.x) {
+            rect_t left = { r.x, band_top, hole.x - r.x, band_bottom - band_top };
+            pieces[count++] = left;
+        }
+        if (h_right < r_right) {
+            rect_t right = { h_right, band_top, r_right - h_right, band_bottom - band_top };
+            pieces[count++] = right;
+        }
+
+        if (n + count > MAX_VISIBLE_RECTS) {
+            out[n++] = r;
+            continue;
+        }
+        for (int j = 0; j < count; j++) out[n++] = pieces[j];
+    }
+
+    for (int i = 0; i < n; i++) region->rects[i] = out[i];
+    region->count = n;
+}
+
+// Recompute every window's visible region after the stack or a window changed
+static void wm_update_visibility() {
+    if (!visibility_dirty) return;
+    int m = ui_px(WINDOW_SHADOW_MARGIN);
+
+    for (int i = 0; i < window_count; i++) {
+        window_t* win = windows[i];
+        region_t* region = &visible[i];
+        region->count = 0;
+        if (!win->is_active) continue;
+
+        rect_t footprint = { win->x - m, win->y - m, win->width + 2 * m, win->height + 2 * m };
+        region->rects[0] = footprint;
+        region->count = 1;
+        for (int j = i + 1; j < window_count && region->count > 0; j++) {
+            window_t* above = windows[j];
+            if (!above->is_active) continue;
+            rect_t frame = { above->x, above->y, above->width, above->height };
+            region_subtract(region, frame);
+        }
+    }
+    visibility_dirty = false;
+}
+
+static const hit_kind_t part_kinds[WINDOW_HIT_PARTS] = {
+    HIT_WINDOW, HIT_TITLE_BAR, HIT_RESIZE_RIGHT, HIT_RESIZE_BOTTOM, HIT_RESIZE_CORNER, HIT_CLOSE
+};
+
+// Screen rectangle of one clickable part of a window
+static rect_t wm_part_rect(window_t* win, int part) {
+    int edge = ui_px(RESIZE_EDGE_SIZE);
+    rect_t r = { win->x, win->y, win->width, win->height };
+    switch (part_kinds[part]) {
+        case HIT_TITLE_BAR:
+            r.height = ui_px(WINDOW_TITLE_HEIGHT);
+            break;
+        case HIT_RESIZE_RIGHT:
+            r.x += win->width - edge;
+            r.width = edge;
+            break;
+        case HIT_RESIZE_BOTTOM:
+            r.y += win->height - edge;
+            r.height = edge;
+            break;
+        case HIT_RESIZE_CORNER:
+            r.x += win->width - edge;
+            r.y += win->height - edge;
+            r.width = edge;
+            r.height = edge;
+            break;
+        case HIT_CLOSE:
+            // Red traffic light, at the spot draw_window() paints it
+            r.x += ui_px(12);
+            r.y += ui_px(7);
+            r.width = ui_px(12);
+            r.height = ui_px(12);
+            break;
+        default:
+            break;
+    }
+    return r;
+}
+
+static void wm_hit_register(window_t* win) {
+    win->hit_z = next_z++;
+    for (int part = 0; part < WINDOW_HIT_PARTS; part++) {
+        rect_t r = wm_part_rect(win, part);
+        win->hit_parts[part] = hittest_add(r.x, r.y, r.width, r.height, part_kinds[part], win, -1,
+                                           win->hit_z * WINDOW_HIT_PARTS + part);
+    }
+}
+
+// Refile the parts after the window moved or changed size
+static void wm_hit_update(window_t* win) {
+    for (int part = 0; part < WINDOW_HIT_PARTS; part++) {
+        rect_t r = wm_part_rect(win, part);
+        hittest_move(win->hit_parts[part], r.x, r.y, r.width, r.height);
+    }
+}
+
+// Move a window to the top of the stack and give it focus
+static void wm_raise(window_t* win) {
+    active_window = win;
+    if (windows[window_count - 1] == win) return;
+
+    int index = 0;
+    while (windows[index] != win) index++;
+    for (int i = index; i < window_count - 1; i++) {
+        windows[i] = windows[i + 1];
+    }
+    windows[window_count - 1] = win;
+    visibility_dirty = true;
+
+    win->hit_z = next_z++;
+    for (int part = 0; part < WINDOW_HIT_PARTS; part++) {
+        hittest_set_layer(win->hit_parts[part], win->hit_z * WINDOW_HIT_PARTS + part);
+    }
+}
+
+// Remember a window's current footprint (frame plus shadow) before it changes
+static void wm_expose_window(window_t* win) {
+    int m = ui_px(WINDOW_SHADOW_MARGIN);
+    int x0 = win->x - m;
+    int y0 = win->y - m;
+    int x1 = win->x + win->width + m;
+    int y1 = win->y + win->height + m;
+
+    if (has_exposed) {
+        if (exposed.x < x0) x0 = exposed.x;
+        if (exposed.y < y0) y0 = exposed.y;
+        if (exposed.x + exposed.width > x1) x1 = exposed.x + exposed.width;
+        if (exposed.y + exposed.height > y1) y1 = exposed.y + exposed.height;
+    }
+    exposed.x = x0;
+    exposed.y = y0;
+    exposed.width = x1 - x0;
+    exposed.height = y1 - y0;
+    has_exposed = true;
+    visibility_dirty = true;
+}
+
+// Shadows are blended, so they must go over fresh background every time they are
+// drawn or they darken frame after frame. Only the ring outside the frame matters.
+static void wm_restore_shadow(window_t* win) {
+    int m = ui_px(WINDOW_SHADOW_MARGIN);
+    int outer_w = win->width + 2 * m;
+    draw_desktop_region(win->x - m, win->y - m, outer_w, m);
+    draw_desktop_region(win->x - m, win->y + win->height, outer_w, m);
+    draw_desktop_region(win->x - m, win->y, m, win->height);
+    draw_desktop_region(win->x + win->width, win->y, m, win->height);
+}
+
+// Copy the cached wallpaper back under what the next wm_render_all() composites:
+// desktop uncovered by windows that moved, and every window's shadow ring.
+// Returns true if the top bar was painted over, so the caller can redraw it.
+bool wm_restore_background() {
+    bool covered_top_bar = false;
+
+    if (has_exposed) {
+        draw_desktop_region(exposed.x, exposed.y, exposed.width, exposed.height);
+        covered_top_bar = exposed.y < ui_px(TOPBAR_HEIGHT);
+        has_exposed = false;
+    }
+
+    // Only the visible parts: rings under another window's frame get painted over
+    wm_update_visibility();
+    for (int i = 0; i < window_count; i++) {
+        window_t* win = windows[i];
+        if (!win->is_active) continue;
+        for (int r = 0; r < visible[i].count; r++) {
+            rect_t* rect = &visible[i].rects[r];
+            graphics_set_clip(rect->x, rect->y, rect->width, rect->height);
+            wm_restore_shadow(win);
+        }
+        if (win->y - ui_px(WINDOW_SHADOW_MARGIN) < ui_px(TOPBAR_HEIGHT)) covered_top_bar = true;
+    }
+    graphics_reset_clip();
+    return covered_top_bar;
+}
+
+// Get backing pixels for a window of the given size: the smallest cached buffer
+// that is big enough, or a fresh one from the heap
+static bool wm_alloc_surface(surface_t* surface, size_t* capacity, int width, int height) {
+    size_t needed = (size_t)width * height;
+    int best = -1;
+    for (int i = 0; i < SURFACE_CACHE_SLOTS; i++) {
+        if (!surface_cache[i].pixels || surface_cache[i].capacity < needed) continue;
+        if (best < 0 || surface_cache[i].capacity < surface_cache[best].capacity) best = i;
+    }
+
+    if (best >= 0) {
+        surface->pixels = surface_cache[best].pixels;
+        *capacity = surface_cache[best].capacity;
+        surface_cache[best].pixels = NULL;
+    } else {
+        surface->pixels = (uint32_t*)malloc(needed * sizeof(uint32_t));
+        if (!surface->pixels) {
+            // The cached buffers are all too small; give them back to the heap
+            // so they can merge into one that fits
+            for (int i = 0; i < SURFACE_CACHE_SLOTS; i++) {
+                free(surface_cache[i].pixels);
+                surface_cache[i].pixels = NULL;
+            }
+            surface->pixels = (uint32_t*)malloc(needed * sizeof(uint32_t));
+            if (!surface->pixels) return false;
+        }
+        *capacity = needed;
+    }
+    surface->width = width;
+    surface->height = height;
+    surface->pitch = width;
+    return true;
+}
+
+// Hand a buffer back to the cache, evicting the smallest one if that is full
+static void wm_release_surface(uint32_t* pixels, size_t capacity) {
+    int slot = -1;
+    for (int i = 0; i < SURFACE_CACHE_SLOTS; i++) {
+        if (!surface_cache[i].pixels) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 || surface_cache[i].capacity < surface_cache[slot].capacity) slot = i;
+    }
+
+    if (surface_cache[slot].pixels) {
+        if (surface_cache[slot].capacity >= capacity) {
+            free(pixels);
+            return;
+        }
+        free(surface_cache[slot].pixels);
+    }
+    surface_cache[slot].pixels = pixels;
+    surface_cache[slot].capacity = capacity;
 }
 
 window_t* wm_create_window(int x, int y, int width, int height, char* title, window_type_t type) {
-    if (window_count >= MAX_WINDOWS) return NULL;
+    if (window_count == window_capacity && !wm_grow_registry()) return NULL;
+    
+    // Keep new windows on screen below the top bar, whatever the resolution
+    if (x + width > graphics_width()) x = graphics_width() - width;
+    if (y + height > graphics_height()) y = graphics_height() - height;
+    if (x < 0) x = 0;
+    if (y < ui_px(TOPBAR_HEIGHT)) y = ui_px(TOPBAR_HEIGHT);
     
-    window_t* win = (window_t*)malloc(sizeof(window_t));
+    window_t* win = (window_t*)pool_alloc(&window_pool);
+    if (!win) return NULL;
+    if (!wm_alloc_surface(&win->surface, &win->surface_capacity, width, height)) {
+        pool_free(&window_pool, win);
+        return NULL;
+    }
     win->x = x;
     win->y = y;
     win->width = width;
@@ -30,130 +375,234 @@ window_t* wm_create_window(int x, int y, int width, int height, char* title, win
     win->is_dragging = false;
     win->is_resizing = false;
     win->resize_mode = RESIZE_NONE;
+    win->frame_dirty = true;
+    win->content_dirty = true;
+    win->dock_icon = -1;
+    wm_hit_register(win);
     
     windows[window_count++] = win;
     active_window = win;
+    visibility_dirty = true;
     return win;
 }
 
-void wm_render_window(window_t* win) {
-    if (!win || !win->is_active) return;
-    
-    // Use the refined draw_window function
-    draw_window(win->x, win->y, win->width, win->height, win->title);
+// Let the app behind a window know it is gone
+static void wm_window_closed(window_t* win) {
+    if (win->type == WINDOW_NANO) {
+        nano_close();
+    }
+    if (win->dock_icon >= 0) {
+        // The dock shows the app as running while any of its windows is open
+        bool still_open = false;
+        for (int i = 0; i < window_count; i++) {
+            if (windows[i]->dock_icon == win->dock_icon) still_open = true;
+        }
+        if (!still_open) dock_set_app_running(win->dock_icon, false);
+    }
+}
+
+void wm_destroy_window(window_t* win) {
+    int index = -1;
+    for (int i = 0; i < window_count; i++) {
+        if (windows[i] == win) index = i;
+    }
+    if (index < 0) return;
+
+    // Uncover the desktop where it was; windows below are composited over that
+    wm_expose_window(win);
+    for (int i = index; i < window_count - 1; i++) {
+        windows[i] = windows[i + 1];
+    }
+    window_count--;
+    if (active_window == win) {
+        active_window = window_count > 0 ? windows[window_count - 1] : NULL;
+    }
+    if (grabbed == win) grabbed = NULL;
+    visibility_dirty = true;
+    for (int part = 0; part < WINDOW_HIT_PARTS; part++) {
+        hittest_remove(win->hit_parts[part]);
+    }
+
+    wm_window_closed(win);
+    wm_release_surface(win->surface.pixels, win->surface_capacity);
+    pool_free(&window_pool, win);
+}
+
+// Topmost window of a type, or NULL
+window_t* wm_find_window(window_type_t type) {
+    for (int i = window_count - 1; i >= 0; i--) {
+        if (windows[i]->type == type) return windows[i];
+    }
+    return NULL;
+}
+
+// Redraw a window's frame, and the content of the types nobody else owns, into
+// its surface. Afterwards the owner (shell, nano) has to redraw its content.
+static void wm_paint_frame(window_t* win) {
+    graphics_set_target(&win->surface);
+    draw_window(0, 0, win->width, win->height, win->title);
     
     // Content area based on type (render inside the window content area)
-    int content_x = win->x + 1;
-    int content_y = win->y + 28; // After title bar
+    int content_x = 1;
+    int content_y = ui_px(28); // After title bar
     int content_w = win->width - 2;
-    int content_h = win->height - 29;
+    int content_h = win->height - ui_px(28) - 1;
+    int pad = ui_px(8);
+    int line = graphics_char_height() + ui_px(8);
     
     if (win->type == WINDOW_TERMINAL) {
-        // Draw black background ONCE - it stays static
+        // Black background; the shell draws its text on top
         draw_rect(content_x + 1, content_y + 1, content_w - 2, content_h - 2, 0xFF000000);
     } else if (win->type == WINDOW_NANO) {
-        // Nano background is drawn by nano_render - don't draw here
+        // Nano background is drawn by nano_render
     } else if (win->type == WINDOW_FILE_BROWSER) {
         // Simple file browser placeholder
-        draw_rect(content_x + 8, content_y + 8, content_w - 16, content_h - 16, 0xFFFFFFFF);
-        draw_string(content_x + 16, content_y + 16, "Files:", COLOR_TEXT_PRIMARY);
+        draw_rect(content_x + pad, content_y + pad, content_w - 2 * pad, content_h - 2 * pad, 0xFFFFFFFF);
+        draw_string(content_x + 2 * pad, content_y + 2 * pad, "Files:", COLOR_TEXT_PRIMARY);
     } else if (win->type == WINDOW_ABOUT) {
         // About window
-        draw_rect(content_x + 8, content_y + 8, content_w - 16, content_h - 16, 0xFFFFFFFF);
-        draw_string(content_x + 16, content_y + 16, "AquaOS v1.0", COLOR_TEXT_PRIMARY);
-        draw_string(content_x + 16, content_y + 32, "Professional macOS-like OS", COLOR_TEXT_SECONDARY);
+        draw_rect(content_x + pad, content_y + pad, content_w - 2 * pad, content_h - 2 * pad, 0xFFFFFFFF);
+        draw_string(content_x + 2 * pad, content_y + 2 * pad, "AquaOS v1.0", COLOR_TEXT_PRIMARY);
+        draw_string(content_x + 2 * pad, content_y + 2 * pad + line, "Professional macOS-like OS", COLOR_TEXT_SECONDARY);
     }
+    
+    graphics_set_target(NULL);
+    win->frame_dirty = false;
+    win->content_dirty = true;
 }
 
+// Composite windows bottom to top: shadow, then one copy from the window's
+// surface, each clipped to its visible region so hidden parts are never drawn
 void wm_render_all() {
+    wm_update_visibility();
     for (int i = 0; i < window_count; i++) {
-        wm_render_window(windows[i]);
+        window_t* win = windows[i];
+        if (!win->is_active) continue;
+        if (win->frame_dirty) wm_paint_frame(win);
+        for (int r = 0; r < visible[i].count; r++) {
+            rect_t* rect = &visible[i].rects[r];
+            graphics_set_clip(rect->x, rect->y, rect->width, rect->height);
+            draw_window_shadow(win->x, win->y, win->width, win->height);
+            blit_rect(win->x, win->y, &win->surface, 0, 0, win->width, win->height);
+        }
     }
+    graphics_reset_clip();
+}
+
+// Owners draw a window's content between these calls, in window coordinates
+// ((0, 0) is the top left of the frame). It shows up at the next wm_render_all().
+void wm_begin_paint(window_t* win) {
+    if (win->frame_dirty) wm_paint_frame(win);
+    graphics_set_target(&win->surface);
+}
+
+void wm_end_paint(window_t* win) {
+    graphics_set_target(NULL);
+    win->content_dirty = false;
 }
 
 bool point_in_rect(int px, int py, int rx, int ry, int rw, int rh) {
     return px >= rx && px < rx + rw && py >= ry && py < ry + rh;
 }
 
-void wm_handle_mouse_down(int x, int y) {
-    #define RESIZE_EDGE_SIZE 8
+// Returns false if the click did not land on a window
+bool wm_handle_mouse_down(int x, int y) {
+    // The click goes to the topmost window under the pointer, which comes to the front
+    hit_t hit = hittest_at(x, y);
+    if (hit.kind < HIT_WINDOW) return false;
+    window_t* win = (window_t*)hit.owner;
+    wm_raise(win);
     
-    // Check if clicking on any window (reverse order for z-index)
-    for (int i = window_count - 1; i >= 0; i--) {
-        window_t* win = windows[i];
-        if (!win->is_active) continue;
-        
-        // Check for resize on edges/corners
-        bool on_right_edge = (x >= win->x + win->width - RESIZE_EDGE_SIZE && x <= win->x + win->width);
-        bool on_bottom_edge = (y >= win->y + win->height - RESIZE_EDGE_SIZE && y <= win->y + win->height);
-        bool in_window = point_in_rect(x, y, win->x, win->y, win->width, win->height);
-        
-        if (in_window && (on_right_edge || on_bottom_edge)) {
+    switch (hit.kind) {
+        case HIT_CLOSE:
+            wm_destroy_window(win);
+            break;
+        case HIT_RESIZE_RIGHT:
+        case HIT_RESIZE_BOTTOM:
+        case HIT_RESIZE_CORNER:
             // Start resizing
             win->is_resizing = true;
             win->resize_start_width = win->width;
             win->resize_start_height = win->height;
             win->drag_offset_x = x;
             win->drag_offset_y = y;
-            
-            if (on_right_edge && on_bottom_edge) {
-                win->resize_mode = RESIZE_BOTTOM_RIGHT;
-            } else if (on_right_edge) {
-                win->resize_mode = RESIZE_RIGHT;
-            } else {
-                win->resize_mode = RESIZE_BOTTOM;
-            }
-            
-            active_window = win;
-            return;
-        }
-        
-        // Check title bar for dragging
-        if (point_in_rect(x, y, win->x, win->y, win->width, WINDOW_TITLE_HEIGHT)) {
+            win->resize_mode = hit.kind == HIT_RESIZE_CORNER ? RESIZE_BOTTOM_RIGHT :
+                               hit.kind == HIT_RESIZE_RIGHT ? RESIZE_RIGHT : RESIZE_BOTTOM;
+            grabbed = win;
+            break;
+        case HIT_TITLE_BAR:
             // Start dragging
             win->is_dragging = true;
             win->drag_offset_x = x - win->x;
             win->drag_offset_y = y - win->y;
-            active_window = win;
-            return;
-        }
+            grabbed = win;
+            break;
+        default:
+            break;
     }
+    return true;
 }
 
 void wm_handle_mouse_up(int x, int y) {
     (void)x; (void)y; // Unused
-    for (int i = 0; i < window_count; i++) {
-        windows[i]->is_dragging = false;
-        windows[i]->is_resizing = false;
-        windows[i]->resize_mode = RESIZE_NONE;
-    }
+    if (!grabbed) return;
+    grabbed->is_dragging = false;
+    grabbed->is_resizing = false;
+    grabbed->resize_mode = RESIZE_NONE;
+    grabbed = NULL;
 }
 
 void wm_handle_mouse_move(int x, int y) {
-    #define MIN_WINDOW_WIDTH 200
-    #define MIN_WINDOW_HEIGHT 150
+    window_t* win = grabbed;
+    if (!win) return;
     
-    for (int i = 0; i < window_count; i++) {
-        window_t* win = windows[i];
+    if (win->is_dragging) {
+        int new_x = x - win->drag_offset_x;
+        int new_y = y - win->drag_offset_y;
+        if (new_x != win->x || new_y != win->y) {
+            wm_expose_window(win);
+            win->x = new_x;
+            win->y = new_y;
+            wm_hit_update(win);
+        }
+    }
+    
+    if (win->is_resizing) {
+        int dx = x - win->drag_offset_x;
+        int dy = y - win->drag_offset_y;
+        int new_width = win->width;
+        int new_height = win->height;
         
-        if (win->is_dragging) {
-            win->x = x - win->drag_offset_x;
-            win->y = y - win->drag_offset_y;
+        if (win->resize_mode == RESIZE_RIGHT || win->resize_mode == RESIZE_BOTTOM_RIGHT) {
+            new_width = win->resize_start_width + dx;
+            if (new_width < ui_px(MIN_WINDOW_WIDTH)) new_width = ui_px(MIN_WINDOW_WIDTH);
         }
         
-        if (win->is_resizing) {
-            int dx = x - win->drag_offset_x;
-            int dy = y - win->drag_offset_y;
-            
-            if (win->resize_mode == RESIZE_RIGHT || win->resize_mode == RESIZE_BOTTOM_RIGHT) {
-                win->width = win->resize_start_width + dx;
-                if (win->width < MIN_WINDOW_WIDTH) win->width = MIN_WINDOW_WIDTH;
-            }
-            
-            if (win->resize_mode == RESIZE_BOTTOM || win->resize_mode == RESIZE_BOTTOM_RIGHT) {
-                win->height = win->resize_start_height + dy;
-                if (win->height < MIN_WINDOW_HEIGHT) win->height = MIN_WINDOW_HEIGHT;
+        if (win->resize_mode == RESIZE_BOTTOM || win->resize_mode == RESIZE_BOTTOM_RIGHT) {
+            new_height = win->resize_start_height + dy;
+            if (new_height < ui_px(MIN_WINDOW_HEIGHT)) new_height = ui_px(MIN_WINDOW_HEIGHT);
+        }
+        
+        if (new_width != win->width || new_height != win->height) {
+            if ((size_t)new_width * new_height <= win->surface_capacity) {
+                // Shrinking (or growing back) fits the buffer we have
+                win->surface.width = new_width;
+                win->surface.height = new_height;
+                win->surface.pitch = new_width;
+            } else {
+                // Keep the old size if there is no memory for the new surface
+                surface_t surface;
+                size_t capacity;
+                if (!wm_alloc_surface(&surface, &capacity, new_width, new_height)) return;
+                wm_release_surface(win->surface.pixels, win->surface_capacity);
+                win->surface = surface;
+                win->surface_capacity = capacity;
             }
+            wm_expose_window(win);
+            win->width = new_width;
+            win->height = new_height;
+            win->frame_dirty = true;
+            wm_hit_update(win);
         }
     }
 }
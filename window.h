@@ -3,9 +3,13 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "graphics.h"
+#include "hittest.h"
 
-#define MAX_WINDOWS 10
+// Lengths below are before UI scaling (see ui_px())
 #define WINDOW_TITLE_HEIGHT 30
+#define WINDOW_SHADOW_MARGIN 4 // Shadow drawn by draw_window() around the frame
+#define WINDOW_HIT_PARTS 6     // body, title bar, three resize handles, close button
 
 typedef enum {
     WINDOW_TERMINAL,
@@ -32,14 +36,26 @@ typedef struct window {
     resize_mode_t resize_mode;
     int drag_offset_x, drag_offset_y;
     int resize_start_width, resize_start_height;
+    surface_t surface;   // Retained frame and content, composited every frame
+    size_t surface_capacity; // Pixels allocated for the surface (>= width * height)
+    bool frame_dirty;    // Frame must be redrawn into the surface (new or resized)
+    bool content_dirty;  // Surface was rebuilt; the owner must redraw its content
+    int dock_icon;       // Dock icon shown as running while this window is open, or -1
+    hit_region_t* hit_parts[WINDOW_HIT_PARTS]; // Clickable areas in the hit-test grid
+    int hit_z;           // Hit-test stacking order, raised with the window
 } window_t;
 
 void wm_init();
 window_t* wm_create_window(int x, int y, int width, int height, char* title, window_type_t type);
+void wm_destroy_window(window_t* win);
+window_t* wm_find_window(window_type_t type);
 void wm_render_all();
-void wm_handle_mouse_down(int x, int y);
+void wm_begin_paint(window_t* win);
+void wm_end_paint(window_t* win);
+bool wm_handle_mouse_down(int x, int y);
 void wm_handle_mouse_up(int x, int y);
 void wm_handle_mouse_move(int x, int y);
 window_t* wm_get_active_window();
+bool wm_restore_background();
 
 #endif